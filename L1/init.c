@@ -16,12 +16,15 @@
 #include "devices/vga.h"
 #include "devices/rtc.h"
 #include "threads/interrupt.h"
+#include "threads/irqtrace.h"
 #include "threads/io.h"
 #include "threads/loader.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
+#include "threads/workqueue.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
@@ -57,6 +60,12 @@ static const char *swap_bdev_name;
 /* -ul: Maximum number of pages to put into palloc's user pool. */
 static size_t user_page_limit = SIZE_MAX;
 
+/* -trace: Record scheduler events? */
+static bool enable_trace;
+
+/* -irqtrace: Time the windows with interrupts off? */
+static bool enable_irqtrace;
+
 static void bss_init(void);
 static void paging_init(void);
 
@@ -96,6 +105,8 @@ int pintos_init(void)
   palloc_init(user_page_limit);
   malloc_init();
   paging_init();
+  if (enable_trace)
+    trace_init();
 
   /* Initialize segmentation. */
 #ifdef USERPROG
@@ -115,8 +126,10 @@ int pintos_init(void)
 
   /* Start thread scheduler and enable interrupts. */
   thread_start();
+  workqueue_init();
   serial_init_queue();
   timer_calibrate();
+  irqtrace_init(enable_irqtrace);
 
 #ifdef FILESYS
   /* Initialize file system. */
@@ -194,10 +207,32 @@ void process_user_command(const char *input, int length, int *exit) {
         long int current_time = rtc_get_time();
         printf("Current time is %ld\n", current_time);
     }
-    else if (compareString(input, "ram", 3, length))
+    else if (compareString(input, "ram", 3, length)) {
         printf("Total RAM is %d kB\n", init_ram_pages * PGSIZE / 1024);
+        palloc_print_stats();
+    }
     else if (compareString(input, "thread", 6, length))
         thread_print_stats();
+    else if (compareString(input, "trace", 5, length))
+        trace_dump();
+    else if (compareString(input, "groups", 6, length))
+        thread_print_groups();
+    else if (compareString(input, "work", 4, length))
+        workqueue_print_stats();
+    else if (compareString(input, "irqoff", 6, length))
+        irqtrace_print_stats();
+    else if (compareString(input, "sleepbench", 10, length))
+        timer_bench();
+    else if (compareString(input, "switchbench", 11, length))
+        thread_switch_bench();
+    else if (compareString(input, "edfbench", 8, length))
+        thread_edf_bench();
+    else if (compareString(input, "stridebench", 11, length))
+        thread_stride_bench();
+#ifdef USERPROG
+    else if (compareString(input, "syscalls", 8, length))
+        syscall_print_stats();
+#endif
     else if (compareString(input, "priority", 8, length)) {
         int _thread_priority = thread_get_priority();
         printf("Thread priority is %d\n", _thread_priority);
@@ -220,6 +255,17 @@ void print_help() {
     printf("time     - Displays the number of seconds passed since Unix epoch\n");
     printf("ram      - Display the amount of RAM available for the OS\n");
     printf("thread   - Displays thread statistics\n");
+    printf("trace    - Dumps the scheduler trace to the serial port\n");
+    printf("groups   - Displays CPU usage and quotas of process groups\n");
+    printf("work     - Displays softirq and workqueue statistics\n");
+    printf("irqoff   - Displays how long interrupts were kept off, and where\n");
+    printf("sleepbench - Times the timer tick with 1,000 threads asleep\n");
+    printf("switchbench - Times a context switch with 5, 50 and 500 threads ready\n");
+    printf("edfbench - Counts EDF deadline misses alone and under CPU-bound load\n");
+    printf("stridebench - Compares requested and achieved CPU shares under -sched=stride\n");
+#ifdef USERPROG
+    printf("syscalls - Displays system call counts and latencies\n");
+#endif
     printf("priority - Displays the thread priority of the current thread\n");
     printf("exit     - Exit interactive shell\n");
 }
@@ -358,6 +404,28 @@ static char **parse_options(char **argv)
       random_init(atoi(value));
     else if (!strcmp(name, "-mlfqs"))
       thread_mlfqs = true;
+    else if (!strcmp(name, "-sched")) {
+      if (!thread_set_policy(value))
+        PANIC("unknown scheduling policy `%s'", value);
+    }
+    else if (!strcmp(name, "-tickless"))
+      timer_tickless = true;
+    else if (!strcmp(name, "-trace"))
+      enable_trace = true;
+    else if (!strcmp(name, "-irqtrace"))
+      enable_irqtrace = true;
+    else if (!strcmp(name, "-irqoff-warn"))
+      irqtrace_warn_us = atoi(value);
+    else if (!strcmp(name, "-watchdog"))
+      irqtrace_watchdog_secs = atoi(value);
+    else if (!strcmp(name, "-tslice-min"))
+      thread_slice_min = atoi(value);
+    else if (!strcmp(name, "-tslice-max"))
+      thread_slice_max = atoi(value);
+    else if (!strcmp(name, "-wakeboost"))
+      thread_wake_boost = atoi(value);
+    else if (!strcmp(name, "-kstack"))
+      thread_kstack_pages = atoi(value);
 #ifdef USERPROG
     else if (!strcmp(name, "-ul"))
       user_page_limit = atoi(value);
@@ -366,6 +434,17 @@ static char **parse_options(char **argv)
       PANIC("unknown option `%s' (use -h for help)", name);
   }
 
+  if (thread_slice_min < 1 || thread_slice_min > thread_slice_max)
+    PANIC("bad time slice range %u...%u", thread_slice_min, thread_slice_max);
+  if (thread_wake_boost < 0 || thread_wake_boost > PRI_MAX - PRI_MIN)
+    PANIC("bad wakeup boost %d", thread_wake_boost);
+  if (thread_kstack_pages < 1 || thread_kstack_pages > KSTACK_PAGES_MAX)
+    PANIC("bad kernel stack size %u pages", thread_kstack_pages);
+  if (irqtrace_warn_us < 0)
+    PANIC("bad interrupts-off warning threshold %d us", irqtrace_warn_us);
+  if (irqtrace_watchdog_secs < 0)
+    PANIC("bad watchdog threshold %d s", irqtrace_watchdog_secs);
+
   /* Initialize the random number generator based on the system
      time. This has no effect if an "-rs" option was specified.
 
@@ -476,6 +555,16 @@ static void usage(void)
 #endif
          "  -rs=SEED           Set random number seed to SEED.\n"
          "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+         "  -sched=POLICY      Use POLICY: priority (default), mlfqs or stride.\n"
+         "  -tickless          Stop the timer tick while the CPU is idle.\n"
+         "  -trace             Record scheduler events for the `trace' command.\n"
+         "  -irqtrace          Time interrupts-off windows for the `irqoff' command.\n"
+         "  -irqoff-warn=US    Report windows of US microseconds or more (default 1000).\n"
+         "  -watchdog=SECS     Report CPUs that do not schedule for SECS seconds.\n"
+         "  -tslice-min=N      Give PRI_MAX threads N-tick time slices (default 2).\n"
+         "  -tslice-max=N      Give PRI_MIN threads N-tick time slices (default 6).\n"
+         "  -wakeboost=N       Raise woken threads' priority by N for a slice.\n"
+         "  -kstack=PAGES      Give each kernel thread PAGES pages of stack (default 2).\n"
 #ifdef USERPROG
          "  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
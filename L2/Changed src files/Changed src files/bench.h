@@ -0,0 +1,32 @@
+#ifndef EXAMPLES_BENCH_H
+#define EXAMPLES_BENCH_H
+
+#include <stdint.h>
+#include <syscall-nr.h>
+
+/* Timing helpers for the benchmark programs.  User code may read
+   the time-stamp counter directly, so timing a loop costs no
+   system call.  See [IA32-v2b] "RDTSC". */
+
+/* Returns the time-stamp counter. */
+static inline uint64_t
+bench_cycles (void)
+{
+  uint32_t lo, hi;
+  asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t) hi << 32) | lo;
+}
+
+/* Returns the number of time-stamp counter cycles per second,
+   measured across a 100 ms sleep_ms() call. */
+static inline uint64_t
+bench_hz (void)
+{
+  uint64_t start = bench_cycles ();
+  asm volatile ("pushl %[ms]; pushl %[number]; int $0x30; addl $8, %%esp"
+                : : [number] "i" (SYS_SLEEP_MS), [ms] "i" (100)
+                : "eax", "memory");
+  return (bench_cycles () - start) * 10;
+}
+
+#endif /* examples/bench.h */
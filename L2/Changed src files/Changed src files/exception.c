@@ -3,6 +3,8 @@
 #include <inttypes.h>
 #include <stdio.h>
 #include "userprog/gdt.h"
+#include "userprog/tss.h"
+#include "userprog/uaccess.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 
@@ -11,6 +13,7 @@ static long long page_fault_cnt;
 
 static void kill (struct intr_frame *);
 static void page_fault (struct intr_frame *);
+static void double_fault (void);
 
 /* Registers handlers for interrupts that can be caused by user
    programs.
@@ -58,6 +61,12 @@ exception_init (void)
      We need to disable interrupts for page faults because the
      fault address is stored in CR2 and needs to be preserved. */
   intr_register_int (14, 0, INTR_OFF, page_fault, "#PF Page-Fault Exception");
+
+  /* A double fault usually means that a kernel stack overflowed
+     into its guard page, leaving no stack to push an interrupt
+     frame on, so it is handled by a task with its own stack. */
+  tss_init_double_fault (double_fault);
+  intr_register_task (8, SEL_DFTSS, "#DF Double Fault Exception");
 }
 
 /* Prints exception statistics. */
@@ -148,6 +157,28 @@ page_fault (struct intr_frame *f)
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
 
+  /* A kernel access to user memory on behalf of a system call,
+     through one of the routines in uaccess.c, resumes at its
+     fixup, which reports the failure to its caller. */
+  if (!user)
+    {
+      uintptr_t fixup = uaccess_fixup ((uintptr_t) f->eip);
+      if (fixup != 0)
+        {
+          f->eip = (void (*) (void)) fixup;
+          return;
+        }
+    }
+
+  /* A kernel access just below a thread's stack is a stack
+     overflow into the guard page, a kernel bug. */
+  if (!user && thread_stack_guard (thread_current (), fault_addr))
+    {
+      intr_dump_frame (f);
+      PANIC ("kernel stack overflow in thread %s (tid %d) at %p",
+             thread_name (), thread_tid (), fault_addr);
+    }
+
   /* To implement virtual memory, delete the rest of the function
      body, and replace it with code that brings in the page to
      which fault_addr refers. */
@@ -161,3 +192,26 @@ page_fault (struct intr_frame *f)
 
 }
 
+/* Double fault task.  The CPU switches here, through a task gate,
+   when it cannot deliver an exception, typically a page fault
+   caused by the kernel stack running into its guard page, which
+   leaves no stack to push the page fault's frame on.  The state
+   at the time of the fault was saved in the kernel TSS by the
+   task switch.  Runs with interrupts off on its own stack and
+   never returns. */
+static void
+double_fault (void)
+{
+  struct thread *t = thread_current ();
+  void *fault_addr, *eip, *esp;
+
+  asm ("movl %%cr2, %0" : "=r" (fault_addr));
+  tss_get_fault_state (&eip, &esp);
+
+  if (thread_stack_guard (t, fault_addr) || thread_stack_guard (t, esp))
+    PANIC ("kernel stack overflow in thread %s (tid %d): "
+           "esp=%p, eip=%p, fault address %p",
+           t->name, t->tid, esp, eip, fault_addr);
+  PANIC ("double fault in thread %s (tid %d): esp=%p, eip=%p",
+         t->name, t->tid, esp, eip);
+}
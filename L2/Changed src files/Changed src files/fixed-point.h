@@ -0,0 +1,57 @@
+#ifndef THREADS_FIXED_POINT_H
+#define THREADS_FIXED_POINT_H
+
+#include <stdint.h>
+
+/* Signed 17.14 fixed-point arithmetic, as used by the
+   multi-level feedback queue scheduler.  A fixed_t holds the
+   real number X as the integer X * FP_F.  See the "4.4BSD
+   Scheduler" appendix of the Pintos reference guide. */
+typedef int fixed_t;
+
+#define FP_SHIFT 14                     /* Fraction bits. */
+#define FP_F (1 << FP_SHIFT)            /* Fixed-point 1.0. */
+
+/* Converts integer N to fixed point. */
+static inline fixed_t
+fp_from_int (int n)
+{
+  return n * FP_F;
+}
+
+/* Converts X to an integer, rounding toward zero. */
+static inline int
+fp_to_int (fixed_t x)
+{
+  return x / FP_F;
+}
+
+/* Converts X to an integer, rounding to nearest. */
+static inline int
+fp_round (fixed_t x)
+{
+  return x >= 0 ? (x + FP_F / 2) / FP_F : (x - FP_F / 2) / FP_F;
+}
+
+/* Returns X + N, for integer N. */
+static inline fixed_t
+fp_add_int (fixed_t x, int n)
+{
+  return x + n * FP_F;
+}
+
+/* Returns X * Y. */
+static inline fixed_t
+fp_mul (fixed_t x, fixed_t y)
+{
+  return ((int64_t) x) * y >> FP_SHIFT;
+}
+
+/* Returns X / Y. */
+static inline fixed_t
+fp_div (fixed_t x, fixed_t y)
+{
+  return (((int64_t) x) << FP_SHIFT) / y;
+}
+
+#endif /* threads/fixed-point.h */
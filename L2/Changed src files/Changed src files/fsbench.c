@@ -0,0 +1,133 @@
+/* fsbench.c
+
+   Measures file system throughput with several processes doing
+   I/O at once.  Each child process reads or writes a file of
+   FILE_SIZE bytes ROUNDS times.  In "read" and "write" mode each
+   child has a file of its own; in "share" mode they all read the
+   same file.  Every mode runs with 1 child and then with PROCS
+   children, so the aggregate throughput of the two can be
+   compared.  Usage: fsbench [PROCS]. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "bench.h"
+
+#define FILE_SIZE 16384         /* Bytes per file. */
+#define ROUNDS 16               /* Passes over the file per child. */
+#define PROCS_MAX 8             /* Maximum number of children. */
+
+static char buf[FILE_SIZE];
+
+/* Stores the name of file I in NAME. */
+static void
+file_name (char name[16], int i)
+{
+  snprintf (name, 16, "fsbench-%d", i);
+}
+
+/* Child: reads or writes file I, according to MODE, ROUNDS
+   times.  Returns true if successful. */
+static bool
+child (const char *mode, int i)
+{
+  bool writing = !strcmp (mode, "write");
+  char name[16];
+  int fd, round;
+
+  file_name (name, !strcmp (mode, "share") ? 0 : i);
+  fd = open (name);
+  if (fd < 0)
+    return false;
+  for (round = 0; round < ROUNDS; round++)
+    {
+      int n = writing ? write (fd, buf, FILE_SIZE) : read (fd, buf, FILE_SIZE);
+      if (n != FILE_SIZE)
+        return false;
+      seek (fd, 0);
+    }
+  close (fd);
+  return true;
+}
+
+/* Runs PROCS children in MODE at once and prints their aggregate
+   throughput.  Returns true if all of them succeeded. */
+static bool
+run (const char *mode, int procs, uint64_t hz)
+{
+  pid_t pids[PROCS_MAX];
+  uint64_t start, cycles, bytes;
+  bool ok = true;
+  int i;
+
+  start = bench_cycles ();
+  for (i = 0; i < procs; i++)
+    {
+      char cmd[32];
+
+      snprintf (cmd, sizeof cmd, "fsbench %s %d", mode, i);
+      pids[i] = exec (cmd);
+      if (pids[i] == PID_ERROR)
+        {
+          printf ("fsbench: exec \"%s\" failed\n", cmd);
+          return false;
+        }
+    }
+  for (i = 0; i < procs; i++)
+    if (wait (pids[i]) != EXIT_SUCCESS)
+      ok = false;
+  cycles = bench_cycles () - start;
+
+  bytes = (uint64_t) procs * FILE_SIZE * ROUNDS;
+  printf ("%-5s %d process(es): %llu bytes, %llu kB/s\n", mode, procs,
+          bytes, cycles != 0 ? bytes * hz / cycles / 1024 : 0);
+  return ok;
+}
+
+int
+main (int argc, char *argv[])
+{
+  static const char *modes[] = {"read", "write", "share"};
+  int procs;
+  uint64_t hz;
+  size_t m;
+  int i;
+
+  if (argc == 3)
+    return child (argv[1], atoi (argv[2])) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+  procs = argc > 1 ? atoi (argv[1]) : 4;
+  if (procs < 1 || procs > PROCS_MAX)
+    {
+      printf ("fsbench: PROCS must be 1...%d\n", PROCS_MAX);
+      return EXIT_FAILURE;
+    }
+
+  /* Create the files and fill them in. */
+  memset (buf, 'x', sizeof buf);
+  for (i = 0; i < procs; i++)
+    {
+      char name[16];
+      int fd;
+
+      file_name (name, i);
+      remove (name);
+      if (!create (name, FILE_SIZE) || (fd = open (name)) < 0)
+        {
+          printf ("fsbench: cannot create %s\n", name);
+          return EXIT_FAILURE;
+        }
+      write (fd, buf, FILE_SIZE);
+      close (fd);
+    }
+
+  hz = bench_hz ();
+  for (m = 0; m < sizeof modes / sizeof *modes; m++)
+    if (!run (modes[m], 1, hz) || !run (modes[m], procs, hz))
+      {
+        printf ("fsbench: %s failed\n", modes[m]);
+        return EXIT_FAILURE;
+      }
+  return EXIT_SUCCESS;
+}
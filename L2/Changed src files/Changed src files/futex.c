@@ -0,0 +1,202 @@
+#include "userprog/futex.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include "threads/spinlock.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Futexes ("fast user-space mutexes").
+
+   A user program builds a lock or condition variable on a word
+   of its own memory, which it updates with atomic instructions,
+   and calls into the kernel only when it has to wait or has a
+   waiter to wake.  The kernel knows nothing about the word's
+   meaning.  futex_sleep() blocks the caller if the word still
+   holds the value that the caller saw, and futex_wakeup() wakes
+   threads blocked on the word.
+
+   Waiters are kept in a hash table keyed by the physical address
+   of the word, so that a word is found no matter which virtual
+   address it is mapped at.  Each bucket has its own spinlock,
+   and the check of the word's value happens under that lock, so
+   a wakeup that follows a change to the word cannot slip in
+   between the check and the waiter going onto the list. */
+
+/* Number of hash buckets. */
+#define FUTEX_BUCKETS 64
+
+/* A hash bucket. */
+struct futex_bucket
+  {
+    struct spinlock lock;       /* Protects WAITERS. */
+    struct list waiters;        /* List of struct futex_waiter. */
+  };
+
+static struct futex_bucket buckets[FUTEX_BUCKETS];
+
+/* A thread blocked in futex_sleep(). */
+struct futex_waiter
+  {
+    struct list_elem elem;      /* Element in bucket's `waiters'. */
+    struct thread *thread;      /* The waiting thread. */
+    uintptr_t key;              /* Physical address of the word. */
+    struct semaphore sema;      /* Upped to wake the thread. */
+    bool queued;                /* Still on the bucket's list? */
+  };
+
+/* Initializes the futex hash table. */
+void
+futex_init (void)
+{
+  int i;
+
+  for (i = 0; i < FUTEX_BUCKETS; i++)
+    {
+      spinlock_init (&buckets[i].lock, "futex");
+      list_init (&buckets[i].waiters);
+    }
+}
+
+/* Returns the bucket for the word with physical address KEY. */
+static struct futex_bucket *
+bucket_for (uintptr_t key)
+{
+  return &buckets[hash_int ((int) key) % FUTEX_BUCKETS];
+}
+
+/* If the user word at kernel virtual address KADDR holds
+   EXPECTED, blocks until futex_wakeup() is called on the same
+   word or TICKS timer ticks pass, whichever comes first.  TICKS
+   < 0 waits indefinitely.  Returns FUTEX_WOKEN, FUTEX_CHANGED
+   if the word did not hold EXPECTED, or FUTEX_TIMEDOUT.  A wait
+   cut short by futex_cancel() counts as woken. */
+int
+futex_sleep (const int *kaddr, int expected, int64_t ticks)
+{
+  struct thread *cur = thread_current ();
+  struct futex_waiter w;
+  struct futex_bucket *b;
+  enum intr_level old_level;
+  bool woken;
+
+  ASSERT (is_kernel_vaddr (kaddr));
+  ASSERT ((uintptr_t) kaddr % sizeof *kaddr == 0);
+
+  w.thread = cur;
+  w.key = vtop (kaddr);
+  sema_init (&w.sema, 0);
+  b = bucket_for (w.key);
+
+  old_level = spinlock_acquire (&b->lock);
+  if (*(volatile const int *) kaddr != expected)
+    {
+      spinlock_release (&b->lock, old_level);
+      return FUTEX_CHANGED;
+    }
+  list_push_back (&b->waiters, &w.elem);
+  w.queued = true;
+  cur->futex_waiter = &w;
+  spinlock_release (&b->lock, old_level);
+
+  if (ticks < 0)
+    {
+      sema_down (&w.sema);
+      return FUTEX_WOKEN;
+    }
+  if (sema_down_timeout (&w.sema, ticks))
+    return FUTEX_WOKEN;
+
+  /* Timed out, unless a wakeup took us off the list in the
+     meantime.  In that case the wakeup counts, and we must wait
+     for its sema_up() before W goes out of scope. */
+  old_level = spinlock_acquire (&b->lock);
+  woken = !w.queued;
+  if (!woken)
+    {
+      list_remove (&w.elem);
+      cur->futex_waiter = NULL;
+    }
+  spinlock_release (&b->lock, old_level);
+  if (woken)
+    sema_down (&w.sema);
+  return woken ? FUTEX_WOKEN : FUTEX_TIMEDOUT;
+}
+
+/* Wakes up to N threads blocked in futex_sleep() on the user
+   word at kernel virtual address KADDR, oldest first.  Returns
+   the number of threads woken. */
+int
+futex_wakeup (const int *kaddr, int n)
+{
+  uintptr_t key = vtop (kaddr);
+  struct futex_bucket *b = bucket_for (key);
+  struct list woken;
+  struct list_elem *e;
+  enum intr_level old_level;
+  int cnt = 0;
+
+  ASSERT (is_kernel_vaddr (kaddr));
+
+  list_init (&woken);
+  old_level = spinlock_acquire (&b->lock);
+  for (e = list_begin (&b->waiters);
+       e != list_end (&b->waiters) && cnt < n; )
+    {
+      struct futex_waiter *w = list_entry (e, struct futex_waiter, elem);
+
+      e = list_next (e);
+      if (w->key == key)
+        {
+          list_remove (&w->elem);
+          w->queued = false;
+          w->thread->futex_waiter = NULL;
+          list_push_back (&woken, &w->elem);
+          cnt++;
+        }
+    }
+  spinlock_release (&b->lock, old_level);
+
+  /* sema_up() may yield, which must not happen with a spinlock
+     held, so wake the waiters now.  Each waiter returns, and its
+     struct futex_waiter goes away, as soon as its semaphore is
+     upped: read the next element first. */
+  for (e = list_begin (&woken); e != list_end (&woken); )
+    {
+      struct futex_waiter *w = list_entry (e, struct futex_waiter, elem);
+
+      e = list_next (e);
+      sema_up (&w->sema);
+    }
+  return cnt;
+}
+
+/* Wakes up thread T if it is blocked in futex_sleep(), so that it
+   notices it has been killed.  T must not be the running thread.
+   Interrupts are off from reading T's wait to taking it off its
+   bucket's list, so T cannot finish the wait in between. */
+void
+futex_cancel (struct thread *t)
+{
+  struct futex_waiter *w;
+  struct futex_bucket *b;
+  enum intr_level old_level;
+
+  ASSERT (t != thread_current ());
+
+  old_level = intr_disable ();
+  w = t->futex_waiter;
+  if (w == NULL)
+    {
+      intr_set_level (old_level);
+      return;
+    }
+  b = bucket_for (w->key);
+  spinlock_acquire (&b->lock);
+  list_remove (&w->elem);
+  w->queued = false;
+  t->futex_waiter = NULL;
+  spinlock_release (&b->lock, old_level);
+  sema_up (&w->sema);
+}
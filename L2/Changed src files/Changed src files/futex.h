@@ -0,0 +1,18 @@
+#ifndef USERPROG_FUTEX_H
+#define USERPROG_FUTEX_H
+
+#include <stdint.h>
+
+struct thread;
+
+/* Results of futex_sleep(). */
+#define FUTEX_WOKEN 0           /* Woken by futex_wakeup(). */
+#define FUTEX_CHANGED 1         /* Word did not hold the expected value. */
+#define FUTEX_TIMEDOUT (-1)     /* Timeout expired first. */
+
+void futex_init (void);
+int futex_sleep (const int *kaddr, int expected, int64_t ticks);
+int futex_wakeup (const int *kaddr, int n);
+void futex_cancel (struct thread *);
+
+#endif /* userprog/futex.h */
@@ -0,0 +1,90 @@
+/* futexbench.c
+
+   Measures the cost of a futex mutex, first taken by one thread
+   alone, when no lock or unlock needs a system call, and then
+   fought over by THREADS threads.  Usage: futexbench [THREADS]. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include <ulock.h>
+#include "bench.h"
+
+/* Lock/unlock pairs per thread. */
+#define ITERATIONS 20000
+
+/* Maximum number of threads. */
+#define THREADS_MAX 8
+
+static struct umutex mutex = UMUTEX_INITIALIZER;
+static volatile int counter;
+
+/* Takes and releases the mutex ITERATIONS times, doing a little
+   work while holding it so that a timer interrupt can catch a
+   thread inside the critical section. */
+static void
+hammer (void *aux UNUSED)
+{
+  int i, j;
+
+  for (i = 0; i < ITERATIONS; i++)
+    {
+      umutex_lock (&mutex);
+      for (j = 0; j < 16; j++)
+        counter++;
+      umutex_unlock (&mutex);
+    }
+}
+
+/* Runs hammer() in THREADS threads at once and prints the cost
+   of each lock/unlock pair.  Returns false if something went
+   wrong. */
+static bool
+run (int threads, uint64_t hz)
+{
+  uthread_t tids[THREADS_MAX];
+  uint64_t start, cycles;
+  int ops = threads * ITERATIONS;
+  int i;
+
+  counter = 0;
+  start = bench_cycles ();
+  for (i = 0; i < threads; i++)
+    {
+      tids[i] = uthread_create (hammer, NULL);
+      if (tids[i] == -1)
+        {
+          printf ("futexbench: uthread_create failed\n");
+          return false;
+        }
+    }
+  for (i = 0; i < threads; i++)
+    uthread_join (tids[i]);
+  cycles = bench_cycles () - start;
+
+  if (counter != ops * 16)
+    {
+      printf ("futexbench: counter is %d, expected %d\n", counter, ops * 16);
+      return false;
+    }
+  printf ("%d thread(s): %d lock/unlock pairs, %llu cycles each, "
+          "%llu pairs/s\n", threads, ops, cycles / ops,
+          cycles != 0 ? ops * hz / cycles : 0);
+  return true;
+}
+
+int
+main (int argc, char *argv[])
+{
+  int threads = argc > 1 ? atoi (argv[1]) : 4;
+  uint64_t hz = bench_hz ();
+
+  if (threads < 1 || threads > THREADS_MAX)
+    {
+      printf ("futexbench: THREADS must be 1...%d\n", THREADS_MAX);
+      return EXIT_FAILURE;
+    }
+  if (!run (1, hz) || !run (threads, hz))
+    return EXIT_FAILURE;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,17 @@
+#ifndef __LIB_IOVEC_H
+#define __LIB_IOVEC_H
+
+#include <stddef.h>
+
+/* A buffer for the readv and writev system calls, which transfer
+   the data of an array of these in order, as one read or write. */
+struct iovec
+  {
+    void *iov_base;             /* Start of buffer. */
+    size_t iov_len;             /* Length of buffer in bytes. */
+  };
+
+/* Maximum number of buffers in one readv or writev call. */
+#define IOV_MAX 64
+
+#endif /* lib/iovec.h */
@@ -0,0 +1,256 @@
+#include "threads/irqtrace.h"
+#include <debug.h>
+#include <stdio.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/tsc.h"
+
+/* Number of call sites tracked.  Windows opened by further
+   sites still go into the histogram. */
+#define IRQTRACE_SITES 64
+
+/* Number of histogram buckets.  Bucket N counts windows of
+   2**N to 2**(N+1) - 1 cycles. */
+#define IRQTRACE_BUCKETS 40
+
+/* Number of sites irqtrace_print_stats() lists. */
+#define IRQTRACE_TOP 10
+
+/* A place in the code that turns interrupts off. */
+struct irqtrace_site
+  {
+    void *site;                 /* Code that turned interrupts off. */
+    void *max_end;              /* Code that ended the longest window. */
+    long long cnt;              /* # of windows. */
+    uint64_t cycles;            /* Total length of the windows. */
+    uint64_t max_cycles;        /* Longest window. */
+  };
+
+/* True while windows are timed.  Tested by the interrupt code
+   before it calls into this module. */
+bool irqtrace_enabled;
+
+/* Windows at least this long are reported; 0 reports none. */
+int irqtrace_warn_us = 1000;
+
+/* Report a soft lockup after this many seconds without a pass
+   through the scheduler; 0 disables the watchdog. */
+int irqtrace_watchdog_secs;
+
+/* The open window, if any. */
+static bool off_open;           /* Are interrupts off? */
+static uint64_t off_tsc;        /* When they were turned off. */
+static void *off_site;          /* Who turned them off. */
+
+/* Statistics. */
+static struct irqtrace_site sites[IRQTRACE_SITES];
+static long long histogram[IRQTRACE_BUCKETS];
+static long long window_cnt;    /* # of windows. */
+static long long untracked_cnt; /* # of windows from sites not in SITES. */
+
+/* Reporting of long windows.  Only the first window over the
+   threshold between two ticks is reported in full. */
+static uint64_t warn_cycles;    /* irqtrace_warn_us in cycles. */
+static bool warn_pending;       /* Is WARN waiting to be printed? */
+static struct irqtrace_site warn; /* Window to report. */
+static int warn_dropped;        /* Further windows since WARN. */
+static uint64_t reported_tsc;   /* When a report was last printed. */
+
+/* Soft-lockup watchdog. */
+static uint64_t watchdog_cycles; /* irqtrace_watchdog_secs in cycles. */
+static uint64_t touched_tsc;    /* Last pass through the scheduler. */
+static bool lockup_reported;    /* Reported since TOUCHED_TSC? */
+
+/* Converts the thresholds to cycles and arms the watchdog, and
+   if TRACE is true starts timing interrupts-off windows.  Must be
+   called after timer_calibrate(). */
+void
+irqtrace_init (bool trace)
+{
+  warn_cycles = timer_us_to_cycles (irqtrace_warn_us);
+  watchdog_cycles = timer_us_to_cycles (irqtrace_watchdog_secs * 1000000ULL);
+  touched_tsc = rdtsc ();
+  irqtrace_enabled = trace;
+}
+
+/* Called with interrupts just turned off by the code at SITE. */
+void
+irqtrace_off (void *site)
+{
+  off_open = true;
+  off_site = site;
+  off_tsc = rdtsc ();
+}
+
+/* Called by the code at SITE just before it turns interrupts
+   back on.  Must not turn interrupts on or off itself. */
+void
+irqtrace_on (void *site)
+{
+  uint64_t cycles;
+  struct irqtrace_site *s = NULL;
+  int bucket;
+  size_t i;
+
+  /* A window can be missed at its start: the return to a new
+     user process turns interrupts on without telling us. */
+  if (!off_open)
+    return;
+  off_open = false;
+  cycles = rdtsc () - off_tsc;
+
+  window_cnt++;
+  bucket = cycles != 0 ? 63 - __builtin_clzll (cycles) : 0;
+  histogram[bucket < IRQTRACE_BUCKETS ? bucket : IRQTRACE_BUCKETS - 1]++;
+
+  /* Find the site's slot by linear probing. */
+  i = ((uintptr_t) off_site >> 2) % IRQTRACE_SITES;
+  for (;;)
+    {
+      s = &sites[i];
+      if (s->site == off_site)
+        break;
+      if (s->site == NULL)
+        {
+          s->site = off_site;
+          break;
+        }
+      i = (i + 1) % IRQTRACE_SITES;
+      if (i == ((uintptr_t) off_site >> 2) % IRQTRACE_SITES)
+        {
+          s = NULL;
+          break;
+        }
+    }
+  if (s != NULL)
+    {
+      s->cnt++;
+      s->cycles += cycles;
+      if (cycles > s->max_cycles)
+        {
+          s->max_cycles = cycles;
+          s->max_end = site;
+        }
+    }
+  else
+    untracked_cnt++;
+
+  /* Queue a report, unless the window includes the printing of
+     the previous one. */
+  if (warn_cycles != 0 && cycles >= warn_cycles && off_tsc > reported_tsc)
+    {
+      if (!warn_pending)
+        {
+          warn_pending = true;
+          warn.site = off_site;
+          warn.max_end = site;
+          warn.max_cycles = cycles;
+        }
+      else
+        warn_dropped++;
+    }
+}
+
+/* Notes a pass through the scheduler, for the watchdog. */
+void
+irqtrace_touch (void)
+{
+  touched_tsc = rdtsc ();
+  lockup_reported = false;
+}
+
+/* Called by the timer interrupt, which interrupted FRAME.  Prints
+   any pending report of a long window and checks for a soft
+   lockup. */
+void
+irqtrace_tick (const struct intr_frame *frame)
+{
+  ASSERT (intr_context ());
+
+  if (warn_pending)
+    {
+      printf ("irqtrace: interrupts off for %llu us, from %p to %p",
+              timer_cycles_to_us (warn.max_cycles), warn.site,
+              warn.max_end);
+      if (warn_dropped > 0)
+        printf (" (and %d more)", warn_dropped);
+      printf ("\n");
+      warn_pending = false;
+      warn_dropped = 0;
+      reported_tsc = rdtsc ();
+    }
+
+  if (watchdog_cycles != 0 && !lockup_reported
+      && rdtsc () - touched_tsc >= watchdog_cycles)
+    {
+      struct thread *t = thread_current ();
+
+      printf ("watchdog: soft lockup, thread %s (tid %d) has run for "
+              "%llu ms without scheduling, at eip %p\n",
+              t->name, t->tid,
+              timer_cycles_to_us (rdtsc () - touched_tsc) / 1000,
+              (void *) frame->eip);
+      lockup_reported = true;
+      reported_tsc = rdtsc ();
+    }
+}
+
+/* Prints the histogram of interrupts-off windows and the sites
+   with the longest ones. */
+void
+irqtrace_print_stats (void)
+{
+  struct irqtrace_site *snap;
+  long long hist[IRQTRACE_BUCKETS];
+  long long windows, untracked;
+  enum intr_level old_level;
+  size_t i, j;
+
+  if (!irqtrace_enabled)
+    {
+      printf ("Interrupts-off tracing is disabled (use -irqtrace).\n");
+      return;
+    }
+
+  snap = malloc (sizeof sites);
+  if (snap == NULL)
+    return;
+
+  old_level = intr_disable ();
+  for (i = 0; i < IRQTRACE_SITES; i++)
+    snap[i] = sites[i];
+  for (i = 0; i < IRQTRACE_BUCKETS; i++)
+    hist[i] = histogram[i];
+  windows = window_cnt;
+  untracked = untracked_cnt;
+  intr_set_level (old_level);
+
+  printf ("Interrupts off: %lld windows, %lld from untracked sites\n",
+          windows, untracked);
+  printf ("%14s %12s %10s\n", "cycles>=", "us>=", "windows");
+  for (i = 0; i < IRQTRACE_BUCKETS; i++)
+    if (hist[i] != 0)
+      printf ("%14llu %12llu %10lld\n", 1ULL << i,
+              timer_cycles_to_us (1ULL << i), hist[i]);
+
+  /* Order the sites by their longest window, longest first. */
+  for (i = 0; i < IRQTRACE_SITES; i++)
+    for (j = i + 1; j < IRQTRACE_SITES; j++)
+      if (snap[j].max_cycles > snap[i].max_cycles)
+        {
+          struct irqtrace_site tmp = snap[i];
+          snap[i] = snap[j];
+          snap[j] = tmp;
+        }
+
+  printf ("%-10s %-10s %10s %12s %12s\n", "off at", "on at", "windows",
+          "avg(us)", "max(us)");
+  for (i = 0; i < IRQTRACE_TOP && snap[i].site != NULL; i++)
+    printf ("%-10p %-10p %10lld %12llu %12llu\n", snap[i].site,
+            snap[i].max_end, snap[i].cnt,
+            timer_cycles_to_us (snap[i].cycles / snap[i].cnt),
+            timer_cycles_to_us (snap[i].max_cycles));
+  free (snap);
+}
@@ -0,0 +1,42 @@
+#ifndef THREADS_IRQTRACE_H
+#define THREADS_IRQTRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct intr_frame;
+
+/* Interrupts-off latency tracer and soft-lockup watchdog.
+
+   When enabled with the "-irqtrace" kernel command-line option,
+   intr_disable(), intr_enable() and intr_set_level() time every
+   window in which interrupts are off, from the code that turned
+   them off to the code that turned them back on.  The interrupt
+   gates count too: a window starts when an interrupt handler is
+   entered from code that had interrupts on and ends when the
+   handler returns to it or turns them on itself.  The tracer
+   keeps a log2 histogram of the window lengths and, for each
+   call site that turns interrupts off, the number of windows and
+   the longest one.  A window longer than "-irqoff-warn=US"
+   microseconds is reported on the console at the next timer
+   tick.
+
+   Independently, "-watchdog=SECS" reports a soft lockup when the
+   CPU goes SECS seconds without a pass through the scheduler,
+   which normally happens at least once per time slice.
+
+   The tracer keeps a single set of statistics, which matches the
+   single CPU that is brought up. */
+
+extern bool irqtrace_enabled;
+extern int irqtrace_warn_us;
+extern int irqtrace_watchdog_secs;
+
+void irqtrace_init (bool trace);
+void irqtrace_off (void *site);
+void irqtrace_on (void *site);
+void irqtrace_touch (void);
+void irqtrace_tick (const struct intr_frame *);
+void irqtrace_print_stats (void);
+
+#endif /* threads/irqtrace.h */
@@ -0,0 +1,308 @@
+#include "threads/palloc.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <inttypes.h>
+#include <round.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/loader.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Page allocator.  Hands out memory in page-size (or
+   page-multiple) chunks.  See malloc.h for an allocator that
+   hands out smaller chunks.
+
+   System memory is divided into two "pools" called the kernel
+   and user pools.  The user pool is for user (virtual) memory
+   pages, the kernel pool for everything else.  The idea here is
+   that the kernel needs to have memory for its own operations
+   even if user processes are swapping like mad.
+
+   By default, half of system RAM is given to the kernel pool and
+   half to the user pool.  That should be huge overkill for the
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Each pool also keeps a small stock of free pages that the idle
+   thread has already filled with zeros, so that single-page
+   PAL_ZERO requests need not clear a page while the caller
+   waits.  Pages in the stock are marked used in the pool's
+   bitmap; they go back to it if the pool runs out. */
+
+/* Number of pre-zeroed pages kept in stock per pool. */
+#define ZEROED_PAGES 32
+
+/* A memory pool. */
+struct pool
+  {
+    struct lock lock;                   /* Mutual exclusion. */
+    struct bitmap *used_map;            /* Bitmap of free pages. */
+    uint8_t *base;                      /* Base of pool. */
+
+    /* Pre-zeroed pages.  Accessed with interrupts off, so that
+       the idle thread can add to it without sleeping. */
+    void *zeroed[ZEROED_PAGES];         /* Stock of zeroed pages. */
+    size_t zeroed_cnt;                  /* Number of pages in stock. */
+    unsigned long long zero_hits;       /* PAL_ZERO served from stock. */
+    unsigned long long zero_misses;     /* PAL_ZERO cleared on demand. */
+  };
+
+/* Two pools: one for kernel data, one for user pages. */
+static struct pool kernel_pool, user_pool;
+
+static void init_pool (struct pool *, void *base, size_t page_cnt,
+                       const char *name);
+static bool page_from_pool (const struct pool *, void *page);
+static void *take_zeroed (struct pool *);
+static bool release_zeroed (struct pool *);
+
+/* Initializes the page allocator.  At most USER_PAGE_LIMIT
+   pages are put into the user pool. */
+void
+palloc_init (size_t user_page_limit)
+{
+  /* Free memory starts at 1 MB and runs to the end of RAM. */
+  uint8_t *free_start = ptov (1024 * 1024);
+  uint8_t *free_end = ptov (init_ram_pages * PGSIZE);
+  size_t free_pages = (free_end - free_start) / PGSIZE;
+  size_t user_pages = free_pages / 2;
+  size_t kernel_pages;
+  if (user_pages > user_page_limit)
+    user_pages = user_page_limit;
+  kernel_pages = free_pages - user_pages;
+
+  /* Give half of memory to kernel, half to user. */
+  init_pool (&kernel_pool, free_start, kernel_pages, "kernel pool");
+  init_pool (&user_pool, free_start + kernel_pages * PGSIZE,
+             user_pages, "user pool");
+}
+
+/* Obtains and returns a group of PAGE_CNT contiguous free pages.
+   If PAL_USER is set, the pages are obtained from the user pool,
+   otherwise from the kernel pool.  If PAL_ZERO is set in FLAGS,
+   then the pages are filled with zeros.  If too few pages are
+   available, returns a null pointer, unless PAL_ASSERT is set in
+   FLAGS, in which case the kernel panics. */
+void *
+palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
+{
+  struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  void *pages;
+  size_t page_idx;
+
+  if (page_cnt == 0)
+    return NULL;
+
+  /* A single zeroed page comes from the stock if there is one. */
+  if (page_cnt == 1 && (flags & PAL_ZERO))
+    {
+      pages = take_zeroed (pool);
+      if (pages != NULL)
+        {
+          pool->zero_hits++;
+          return pages;
+        }
+      pool->zero_misses++;
+    }
+
+  lock_acquire (&pool->lock);
+  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
+  while (page_idx == BITMAP_ERROR && release_zeroed (pool))
+    page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
+  lock_release (&pool->lock);
+
+  if (page_idx != BITMAP_ERROR)
+    pages = pool->base + PGSIZE * page_idx;
+  else
+    pages = NULL;
+
+  if (pages != NULL) 
+    {
+      if (flags & PAL_ZERO)
+        memset (pages, 0, PGSIZE * page_cnt);
+    }
+  else 
+    {
+      if (flags & PAL_ASSERT)
+        PANIC ("palloc_get: out of pages");
+    }
+
+  return pages;
+}
+
+/* Obtains a single free page and returns its kernel virtual
+   address.
+   If PAL_USER is set, the page is obtained from the user pool,
+   otherwise from the kernel pool.  If PAL_ZERO is set in FLAGS,
+   then the page is filled with zeros.  If no pages are
+   available, returns a null pointer, unless PAL_ASSERT is set in
+   FLAGS, in which case the kernel panics. */
+void *
+palloc_get_page (enum palloc_flags flags) 
+{
+  return palloc_get_multiple (flags, 1);
+}
+
+/* Frees the PAGE_CNT pages starting at PAGES. */
+void
+palloc_free_multiple (void *pages, size_t page_cnt) 
+{
+  struct pool *pool;
+  size_t page_idx;
+
+  ASSERT (pg_ofs (pages) == 0);
+  if (pages == NULL || page_cnt == 0)
+    return;
+
+  if (page_from_pool (&kernel_pool, pages))
+    pool = &kernel_pool;
+  else if (page_from_pool (&user_pool, pages))
+    pool = &user_pool;
+  else
+    NOT_REACHED ();
+
+  page_idx = pg_no (pages) - pg_no (pool->base);
+
+#ifndef NDEBUG
+  memset (pages, 0xcc, PGSIZE * page_cnt);
+#endif
+
+  ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
+  bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+}
+
+/* Frees the page at PAGE. */
+void
+palloc_free_page (void *page) 
+{
+  palloc_free_multiple (page, 1);
+}
+
+/* Adds one freshly zeroed page to POOL's stock.  Returns false if
+   there is nothing more to do for now. */
+static bool
+zero_one_page (struct pool *pool)
+{
+  enum intr_level old_level;
+  size_t page_idx;
+  void *page;
+
+  if (pool->zeroed_cnt >= ZEROED_PAGES || !lock_try_acquire (&pool->lock))
+    return false;
+  page_idx = bitmap_scan_and_flip (pool->used_map, 0, 1, false);
+  lock_release (&pool->lock);
+  if (page_idx == BITMAP_ERROR)
+    return false;
+
+  page = pool->base + PGSIZE * page_idx;
+  memset (page, 0, PGSIZE);
+
+  old_level = intr_disable ();
+  ASSERT (pool->zeroed_cnt < ZEROED_PAGES);
+  pool->zeroed[pool->zeroed_cnt++] = page;
+  intr_set_level (old_level);
+  return true;
+}
+
+/* Called by the idle thread, with interrupts on, to fill the
+   stocks of zeroed pages.  A thread that becomes ready in the
+   meantime preempts the idle thread as usual.  Never sleeps: if
+   a pool's lock is busy, that pool is skipped until next time. */
+void
+palloc_zero_idle (void)
+{
+  ASSERT (intr_get_level () == INTR_ON);
+
+  while (zero_one_page (&kernel_pool))
+    continue;
+  while (zero_one_page (&user_pool))
+    continue;
+}
+
+/* Prints statistics about the pre-zeroed page stocks. */
+void
+palloc_print_stats (void)
+{
+  struct pool *pools[] = {&kernel_pool, &user_pool};
+  const char *names[] = {"kernel", "user"};
+  size_t i;
+
+  for (i = 0; i < sizeof pools / sizeof *pools; i++)
+    {
+      struct pool *p = pools[i];
+      unsigned long long total = p->zero_hits + p->zero_misses;
+
+      printf ("Zeroed %s pages: %zu in stock, %llu hits, %llu misses "
+              "(%llu%% hit rate)\n", names[i], p->zeroed_cnt,
+              p->zero_hits, p->zero_misses,
+              total != 0 ? p->zero_hits * 100 / total : 0);
+    }
+}
+
+/* Removes and returns a page from POOL's stock of zeroed pages,
+   or a null pointer if it is empty. */
+static void *
+take_zeroed (struct pool *pool)
+{
+  enum intr_level old_level;
+  void *page = NULL;
+
+  old_level = intr_disable ();
+  if (pool->zeroed_cnt > 0)
+    page = pool->zeroed[--pool->zeroed_cnt];
+  intr_set_level (old_level);
+  return page;
+}
+
+/* Returns one page from POOL's stock of zeroed pages to its
+   bitmap, so that an allocation that would otherwise fail can
+   use it.  Returns false if the stock is empty.  POOL's lock
+   must be held. */
+static bool
+release_zeroed (struct pool *pool)
+{
+  void *page = take_zeroed (pool);
+
+  ASSERT (lock_held_by_current_thread (&pool->lock));
+
+  if (page == NULL)
+    return false;
+  bitmap_reset (pool->used_map, pg_no (page) - pg_no (pool->base));
+  return true;
+}
+
+/* Initializes pool P as starting at START and ending at END,
+   naming it NAME for debugging purposes. */
+static void
+init_pool (struct pool *p, void *base, size_t page_cnt, const char *name) 
+{
+  /* We'll put the pool's used_map at its base.
+     Calculate the space needed for the bitmap
+     and subtract it from the pool's size. */
+  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
+  if (bm_pages > page_cnt)
+    PANIC ("Not enough memory in %s for bitmap.", name);
+  page_cnt -= bm_pages;
+
+  printf ("%zu pages available in %s.\n", page_cnt, name);
+
+  /* Initialize the pool. */
+  lock_init (&p->lock);
+  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
+  p->base = base + bm_pages * PGSIZE;
+}
+
+/* Returns true if PAGE was allocated from POOL,
+   false otherwise. */
+static bool
+page_from_pool (const struct pool *pool, void *page) 
+{
+  uintptr_t page_no = pg_no (page);
+  uintptr_t start_page = pg_no (pool->base);
+  uintptr_t end_page = start_page + bitmap_size (pool->used_map);
+
+  return page_no >= start_page && page_no < end_page;
+}
@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "userprog/futex.h"
 #include "userprog/gdt.h"
 #include "userprog/pagedir.h"
 #include "userprog/tss.h"
@@ -21,12 +22,23 @@
 #include "devices/timer.h"
 //Harikishna -210206B
 static thread_func start_process NO_RETURN;
+static thread_func start_thread NO_RETURN;
+static bool process_create (struct thread *);
+static bool install_page (void *upage, void *kpage, bool writable);
 static bool load (const char *cmdline, void (**eip) (void), void **esp,
 		  char **save_ptr);
 #define DEFAULT_ARGV_SIZE  2
 #define WORD_SIZE 4
 #define MAX_CMD_LINE 512
 
+/* User stacks of threads other than a process's first.  Slot N,
+   for N >= 1, is USTACK_PAGES pages ending USTACK_SLOT_SIZE * N
+   bytes below PHYS_BASE, so the pages between one slot and the
+   next, including those below the first thread's stack, stay
+   unmapped and catch overflows. */
+#define USTACK_PAGES 4
+#define USTACK_SLOT_SIZE ((USTACK_PAGES + 1) * PGSIZE)
+
 /* Starts a new thread running a user program loaded from
    FILENAME.  The new thread may be scheduled (and may even exit)
    before process_execute() returns.  Returns the new process's
@@ -38,8 +50,6 @@ process_execute (const char *file_name)
   char *save_ptr;
   struct file *file;
   tid_t tid;
-  struct list *clist = &(thread_current ()->child_meta_list);
-  struct list_elem *e;
   struct child_metadata *md;
 
   if (strlen (file_name) > MAX_CMD_LINE)
@@ -64,19 +74,14 @@ process_execute (const char *file_name)
     palloc_free_page (fn_copy); 
   else 
   {
-    for (e = list_begin (clist); e != list_end (clist);
-	 e = list_next (e))
+    md = thread_find_metadata (tid);
+    if (md != NULL)
     {
-      md = list_entry (e, struct child_metadata, infoelem);
-      if (tid == md->tid)
-      {
-        sema_down (&md->child_load);
-        if (md->load_success == false)
-          tid = TID_ERROR;
-        sema_up (&md->child_load);
-        break;
-      }
-     }
+      sema_down (&md->child_load);
+      if (md->load_success == false)
+        tid = TID_ERROR;
+      sema_up (&md->child_load);
+    }
   }
   return tid;
 }
@@ -91,10 +96,19 @@ start_process (void *file_name_)
   struct intr_frame if_;
   bool success;
   struct thread *cur = thread_current ();
+  struct child_metadata *md = cur->md;
+
+  if (!process_create (cur))
+    {
+      palloc_free_page (file_name);
+      md->load_success = false;
+      sema_up (&md->child_load);
+      thread_exit ();
+    }
 
   file_name = strtok_r (file_name, " ", &save_ptr);
   struct file *file = filesys_open (file_name);
-  thread_current ()->md->exec_file = file;
+  md->exec_file = file;
 
   /* Initialize interrupt frame and load executable. */
   memset (&if_, 0, sizeof if_);
@@ -108,14 +122,14 @@ start_process (void *file_name_)
 
   if (!success)
   {
-    cur->md->load_success = false; 
-    sema_up (&(cur->md->child_load));
+    md->load_success = false; 
+    sema_up (&md->child_load);
     thread_exit ();
   }
   else
   {
-    cur->md->load_success = true;
-    sema_up (&(cur->md->child_load));
+    md->load_success = true;
+    sema_up (&md->child_load);
   }
 
   /* Start the user process by simulating a return from an
@@ -124,6 +138,7 @@ start_process (void *file_name_)
      arguments on the stack in the form of a `struct intr_frame',
      we just point the stack pointer (%esp) to our stack frame
      and jump to it. */
+  thread_enter_user ();
   asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
   NOT_REACHED ();
 }
@@ -135,39 +150,148 @@ start_process (void *file_name_)
    been successfully called for the given TID, returns -1
    immediately, without waiting.
 
-   This function will be implemented in problem 2-2.  For now, it
-   does nothing. */
+   While we wait, our priority is donated to the child, so that a
+   high-priority parent is not held up by a low-priority child
+   being starved by medium-priority threads. */
 int
 process_wait (tid_t child_tid) 
 {
   int exit_status = -1;
-  struct list_elem *e;
   struct child_metadata *md;
-  struct list *clist = &(thread_current ()->child_meta_list);
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
 
-  for (e = list_begin (clist); e != list_end (clist);
-       e = list_next (e))
+  md = thread_find_metadata (child_tid);
+  if (md != NULL && md->parent_tid == cur->tid && !md->user_thread)
   {
-    md = list_entry (e, struct child_metadata, infoelem);
-    if ((md->tid == child_tid))
+    old_level = intr_disable ();
+    if (md->thread != NULL)
+      thread_donate (cur, md->thread);
+    intr_set_level (old_level);
+    sema_down (&md->completed);
+    old_level = intr_disable ();
+    thread_undonate (cur);
+    intr_set_level (old_level);
+    exit_status = md->exit_status;
+    list_remove (&md->infoelem);
+    thread_free_metadata (md);
+  }
+  return exit_status;
+}
+
+/* Creates the process of thread T, its first thread, and moves
+   T's metadata into it.  Returns false if memory is short. */
+static bool
+process_create (struct thread *t)
+{
+  struct process *p = calloc (1, sizeof *p);
+
+  if (p == NULL)
+    return false;
+  p->md = t->md;
+  lock_init (&p->lock);
+  lock_init (&p->uring_lock);
+  list_init (&p->threads);
+  list_push_back (&p->threads, &t->process_elem);
+  p->stack_map = 1;             /* Slot 0 is T's stack from setup_stack(). */
+
+  t->md = NULL;
+  t->process = p;
+  t->fd = p->fd;
+  t->ustack_slot = 0;
+  return true;
+}
+
+/* Returns the user address just above the stack in SLOT. */
+static uint8_t *
+ustack_top (int slot)
+{
+  return (uint8_t *) PHYS_BASE - slot * USTACK_SLOT_SIZE;
+}
+
+/* Unmaps and frees the pages of the user stack in SLOT of the
+   process with page directory PD. */
+static void
+free_ustack (uint32_t *pd, int slot)
+{
+  uint8_t *upage;
+
+  for (upage = ustack_top (slot) - USTACK_PAGES * PGSIZE;
+       upage < ustack_top (slot); upage += PGSIZE)
     {
-      sema_down (&md->completed);
-      exit_status = md->exit_status;
-      sema_up (&md->completed);
-      list_remove (e);
-      free (md); 
-      break;
+      void *kpage = pagedir_get_page (pd, upage);
+
+      if (kpage != NULL)
+        {
+          pagedir_clear_page (pd, upage);
+          palloc_free_page (kpage);
+        }
     }
-  }      
-  return exit_status;
 }
 
-/* Free the current process's resources. */
+/* Takes the current thread out of its process.  The last thread
+   to leave frees the process's resources and reports its exit
+   to the parent. */
 void
 process_exit (void)
 {
   struct thread *cur = thread_current ();
+  struct process *p = cur->process;
   uint32_t *pd;
+  bool last;
+
+  if (p == NULL)
+    return;
+
+  lock_acquire (&p->lock);
+  list_remove (&cur->process_elem);
+  last = list_empty (&p->threads);
+  if (!last)
+    {
+      if (cur->ustack_slot != 0)
+        {
+          free_ustack (p->pagedir, cur->ustack_slot);
+          p->stack_map &= ~(1u << cur->ustack_slot);
+        }
+
+      /* Our parent may be waiting on the process's metadata and
+         donating priority to us.  Hand the metadata and the
+         donation over to a thread that is still running.  The
+         other donors are waiting on our locks and stay ours. */
+      if (p->md->thread == cur)
+        {
+          struct thread *next = list_entry (list_front (&p->threads),
+                                            struct thread, process_elem);
+          enum intr_level old_level = intr_disable ();
+          struct list_elem *e;
+
+          p->md->thread = next;
+          for (e = list_begin (&cur->donors); e != list_end (&cur->donors);
+               e = list_next (e))
+            {
+              struct thread *donor = list_entry (e, struct thread,
+                                                 donor_elem);
+              if (donor->tid == p->md->parent_tid)
+                {
+                  thread_undonate (donor);
+                  thread_donate (donor, next);
+                  break;
+                }
+            }
+          intr_set_level (old_level);
+        }
+    }
+  lock_release (&p->lock);
+
+  cur->process = NULL;
+  cur->fd = NULL;
+  if (!last)
+    {
+      /* The page directory stays in use by our siblings.  Leaving
+         it loaded until the next switch is harmless. */
+      cur->pagedir = NULL;
+      return;
+    }
 
   /* Destroy the current process's page directory and switch back
      to the kernel-only page directory. */
@@ -185,6 +309,9 @@ process_exit (void)
       pagedir_activate (NULL);
       pagedir_destroy (pd);
     }
+  thread_release_metadata (p->md);
+  free (p->syscall_stats);
+  free (p);
 }
 
 /* Sets up the CPU for running user code in the current
@@ -194,9 +321,16 @@ void
 process_activate (void)
 {
   struct thread *t = thread_current ();
+  uint32_t *pd = t->pagedir != NULL ? t->pagedir : init_page_dir;
+  uintptr_t cr3;
 
-  /* Activate thread's page tables. */
-  pagedir_activate (t->pagedir);
+  /* Activate thread's page tables, unless they are already
+     loaded, as when switching between threads of one process.
+     Reloading CR3 flushes the TLB, which then has to be refilled
+     from the same page tables. */
+  asm volatile ("movl %%cr3, %0" : "=r" (cr3));
+  if (cr3 != vtop (pd))
+    pagedir_activate (t->pagedir);
 
   /* Set thread's kernel stack for use in processing
      interrupts. */
@@ -288,7 +422,7 @@ load (const char *file_name, void (**eip) (void), void **esp,
   int i;
 
   /* Allocate and activate page directory. */
-  t->pagedir = pagedir_create ();
+  t->pagedir = t->process->pagedir = pagedir_create ();
   if (t->pagedir == NULL) 
     goto done;
   process_activate ();
@@ -390,8 +524,6 @@ load (const char *file_name, void (**eip) (void), void **esp,
 
 /* load() helpers. */
 
-static bool install_page (void *upage, void *kpage, bool writable);
-
 /* Checks whether PHDR describes a valid, loadable segment in
    FILE and returns true if so, false otherwise. */
 static bool
@@ -468,8 +600,10 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
       size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
-      /* Get a page of memory. */
-      uint8_t *kpage = palloc_get_page (PAL_USER);
+      /* Get a page of memory.  A page with nothing to read, as in
+         .bss, is likely to come pre-zeroed. */
+      uint8_t *kpage = palloc_get_page (page_read_bytes == 0
+                                        ? PAL_USER | PAL_ZERO : PAL_USER);
       if (kpage == NULL)
         return false;
 
@@ -479,7 +613,8 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
           palloc_free_page (kpage);
           return false; 
         }
-      memset (kpage + page_read_bytes, 0, page_zero_bytes);
+      if (page_read_bytes != 0)
+        memset (kpage + page_read_bytes, 0, page_zero_bytes);
 
       /* Add the page to the process's address space. */
       if (!install_page (upage, kpage, writable)) 
@@ -592,3 +727,196 @@ install_page (void *upage, void *kpage, bool writable)
   return (pagedir_get_page (t->pagedir, upage) == NULL
           && pagedir_set_page (t->pagedir, upage, kpage, writable));
 }
+
+/* Where a new thread of a process starts in user mode. */
+struct thread_start
+  {
+    struct process *process;            /* Process to join. */
+    int ustack_slot;                    /* Slot of the user stack. */
+    void (*eip) (void);                 /* User code to run. */
+    void *esp;                          /* Initial user stack pointer. */
+  };
+
+/* Starts a new thread in the current process.  It runs START in
+   user mode, as if called as START (FUNC, AUX), on a user stack
+   of its own below the first thread's.  Returns the new thread's
+   tid, which only the caller may pass to process_thread_join(),
+   or TID_ERROR if the process is exiting, already has
+   PROCESS_THREAD_MAX threads, or memory is short. */
+tid_t
+process_thread_create (void (*start) (void), void *func, void *aux)
+{
+  struct thread *cur = thread_current ();
+  struct process *p = cur->process;
+  struct thread_start *ts;
+  struct child_metadata *md;
+  uint32_t *frame;
+  uint8_t *upage;
+  void *kpage = NULL;
+  tid_t tid = TID_ERROR;
+  int slot;
+
+  ASSERT (p != NULL);
+
+  ts = malloc (sizeof *ts);
+  if (ts == NULL)
+    return TID_ERROR;
+
+  /* The new thread may run as soon as thread_create() makes it
+     ready.  It joins P from what TS tells it, then takes P's
+     lock, so holding the lock until the thread is on P's list
+     keeps it from reaching user mode ahead of us. */
+  lock_acquire (&p->lock);
+  if (p->exiting || p->stack_map == (uint32_t) -1)
+    goto done;
+  slot = __builtin_ctz (~p->stack_map);
+  p->stack_map |= 1u << slot;
+
+  for (upage = ustack_top (slot) - USTACK_PAGES * PGSIZE;
+       upage < ustack_top (slot); upage += PGSIZE)
+    {
+      kpage = palloc_get_page (PAL_USER | PAL_ZERO);
+      if (kpage == NULL || !install_page (upage, kpage, true))
+        {
+          palloc_free_page (kpage);
+          goto fail;
+        }
+    }
+
+  /* Set up the stack as if START had just been called with FUNC
+     and AUX as its arguments.  KPAGE is the top page. */
+  frame = (uint32_t *) ((uint8_t *) kpage + PGSIZE) - 3;
+  frame[0] = 0;                         /* Return address. */
+  frame[1] = (uint32_t) func;
+  frame[2] = (uint32_t) aux;
+  ts->process = p;
+  ts->ustack_slot = slot;
+  ts->eip = start;
+  ts->esp = ustack_top (slot) - 3 * sizeof (uint32_t);
+
+  /* The new thread gets our base priority, not our donations or
+     wakeup boost. */
+  tid = thread_create (cur->name, cur->base_priority, start_thread, ts);
+  if (tid == TID_ERROR)
+    goto fail;
+
+  /* It is our child, so its metadata stays put, and it cannot
+     exit while we hold P's lock. */
+  md = thread_find_metadata (tid);
+  md->user_thread = true;
+  list_push_back (&p->threads, &md->thread->process_elem);
+  lock_release (&p->lock);
+  return tid;
+
+ fail:
+  free_ustack (p->pagedir, slot);
+  p->stack_map &= ~(1u << slot);
+ done:
+  lock_release (&p->lock);
+  free (ts);
+  return tid;
+}
+
+/* A thread function that starts a thread created by
+   process_thread_create() in user mode. */
+static void
+start_thread (void *ts_)
+{
+  struct thread_start *ts = ts_;
+  struct thread *cur = thread_current ();
+  struct intr_frame if_;
+
+  /* Join the process, then wait for our creator to finish
+     setting us up. */
+  cur->process = ts->process;
+  cur->fd = ts->process->fd;
+  cur->pagedir = ts->process->pagedir;
+  cur->ustack_slot = ts->ustack_slot;
+  lock_acquire (&cur->process->lock);
+  lock_release (&cur->process->lock);
+  process_activate ();
+
+  memset (&if_, 0, sizeof if_);
+  if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
+  if_.cs = SEL_UCSEG;
+  if_.eflags = FLAG_IF | FLAG_MBS;
+  if_.eip = ts->eip;
+  if_.esp = ts->esp;
+  free (ts);
+
+  process_check_killed ();
+  thread_enter_user ();
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+
+/* Waits for thread TID, which the current thread must have
+   created with process_thread_create(), to exit.  Returns 0 if
+   successful, -1 if TID is not such a thread or has already been
+   joined. */
+int
+process_thread_join (tid_t tid)
+{
+  struct child_metadata *md = thread_find_metadata (tid);
+
+  if (md == NULL || md->parent_tid != thread_tid () || !md->user_thread)
+    return -1;
+  sema_down (&md->completed);
+  list_remove (&md->infoelem);
+  thread_free_metadata (md);
+  return 0;
+}
+
+/* Returns the number of threads in the current process. */
+int
+process_thread_cnt (void)
+{
+  struct process *p = thread_current ()->process;
+  int cnt;
+
+  lock_acquire (&p->lock);
+  cnt = list_size (&p->threads);
+  lock_release (&p->lock);
+  return cnt;
+}
+
+/* Marks the current process as exiting and tells its other
+   threads to exit.  Each does so the next time it is about to
+   return to user mode.  A thread blocked in futex_wait() is
+   woken up for the purpose; one blocked elsewhere in the kernel
+   exits once that wait is over.  No new threads can be created
+   afterward. */
+void
+process_kill_siblings (void)
+{
+  struct thread *cur = thread_current ();
+  struct process *p = cur->process;
+  struct list_elem *e;
+
+  lock_acquire (&p->lock);
+  p->exiting = true;
+  for (e = list_begin (&p->threads); e != list_end (&p->threads);
+       e = list_next (e))
+    {
+      struct thread *t = list_entry (e, struct thread, process_elem);
+
+      if (t != cur)
+        {
+          t->killed = true;
+          futex_cancel (t);
+        }
+    }
+  lock_release (&p->lock);
+}
+
+/* Exits the current thread if its process is exiting.  Called
+   just before returning to user mode. */
+void
+process_check_killed (void)
+{
+  if (thread_current ()->killed)
+    {
+      intr_enable ();
+      thread_exit ();
+    }
+}
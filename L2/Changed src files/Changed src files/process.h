@@ -0,0 +1,48 @@
+#ifndef USERPROG_PROCESS_H
+#define USERPROG_PROCESS_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Maximum number of threads in a process, including the first. */
+#define PROCESS_THREAD_MAX 32
+
+/* State shared by the threads of a user process.  The process
+   lives until its last thread exits. */
+struct process
+  {
+    uint32_t *pagedir;                  /* Page directory. */
+    struct file *fd[MAX_FD];            /* Open files. */
+    struct child_metadata *md;          /* For our parent's wait(). */
+    struct syscall_stats *syscall_stats; /* Per system call, or null. */
+
+    /* Rings registered with uring_setup(), all user addresses. */
+    struct lock uring_lock;             /* Protects the rings. */
+    struct uring *uring;                /* Ring indexes, or null. */
+    unsigned uring_entries;             /* Entries in each ring. */
+    struct uring_sqe *uring_sqes;       /* Submission ring. */
+    struct uring_cqe *uring_cqes;       /* Completion ring. */
+
+    struct lock lock;                   /* Protects the members below. */
+    int fd_pins[MAX_FD];                /* System calls using each file. */
+    bool fd_closing[MAX_FD];            /* Closed while pinned. */
+    struct list threads;                /* Threads not yet exited. */
+    uint32_t stack_map;                 /* User stack slots in use. */
+    bool exiting;                       /* exit() called: threads must die. */
+  };
+
+tid_t process_execute (const char *file_name);
+int process_wait (tid_t);
+void process_exit (void);
+void process_activate (void);
+
+tid_t process_thread_create (void (*start) (void), void *func, void *aux);
+int process_thread_join (tid_t);
+int process_thread_cnt (void);
+void process_kill_siblings (void);
+void process_check_killed (void);
+
+#endif /* userprog/process.h */
@@ -0,0 +1,78 @@
+#ifndef THREADS_SPINLOCK_H
+#define THREADS_SPINLOCK_H
+
+#include <debug.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "threads/interrupt.h"
+
+/* A spinlock, for data shared between CPUs that is touched only
+   for a few instructions at a time, such as the run queues.
+
+   Acquiring a spinlock also turns interrupts off on the local
+   CPU, because an interrupt handler that tried to take a lock
+   already held by the code it interrupted would spin forever.
+   spinlock_acquire() returns the previous interrupt level, which
+   must be passed back to spinlock_release().  Spinlocks are not
+   recursive and a thread must never sleep while holding one.
+
+   On a single CPU, the atomic exchange always succeeds the first
+   time, so a spinlock costs little more than turning interrupts
+   off. */
+struct spinlock
+  {
+    volatile uint32_t locked;   /* Nonzero while held. */
+    const char *name;           /* Name (for debugging purposes). */
+  };
+
+/* Initializes spinlock L, named NAME, as unlocked. */
+static inline void
+spinlock_init (struct spinlock *l, const char *name)
+{
+  l->locked = 0;
+  l->name = name;
+}
+
+/* Turns interrupts off and acquires spinlock L, spinning until
+   it is free.  Returns the previous interrupt level. */
+static inline enum intr_level
+spinlock_acquire (struct spinlock *l)
+{
+  enum intr_level old_level = intr_disable ();
+  uint32_t held = 1;
+
+  for (;;)
+    {
+      /* See [IA32-v2b] "XCHG": with a memory operand it is
+         locked implicitly. */
+      asm volatile ("xchgl %0, %1" : "+r" (held), "+m" (l->locked)
+                    : : "memory");
+      if (!held)
+        break;
+      while (l->locked)
+        asm volatile ("pause" : : : "memory");
+      held = 1;
+    }
+  return old_level;
+}
+
+/* Releases spinlock L, which must be held, and restores the
+   interrupt level to OLD_LEVEL. */
+static inline void
+spinlock_release (struct spinlock *l, enum intr_level old_level)
+{
+  ASSERT (l->locked);
+
+  asm volatile ("movl $0, %0" : "=m" (l->locked) : : "memory");
+  intr_set_level (old_level);
+}
+
+/* Returns true if spinlock L is held by some CPU.  Useful only
+   in assertions. */
+static inline bool
+spinlock_held (const struct spinlock *l)
+{
+  return l->locked != 0;
+}
+
+#endif /* threads/spinlock.h */
@@ -0,0 +1,676 @@
+/* This file is derived from source code for the Nachos
+   instructional operating system.  The Nachos copyright notice
+   is reproduced in full below. */
+
+/* Copyright (c) 1992-1996 The Regents of the University of California.
+   All rights reserved.
+
+   Permission to use, copy, modify, and distribute this software
+   and its documentation for any purpose, without fee, and
+   without written agreement is hereby granted, provided that the
+   above copyright notice and the following two paragraphs appear
+   in all copies of this software.
+
+   IN NO EVENT SHALL THE UNIVERSITY OF CALIFORNIA BE LIABLE TO
+   ANY PARTY FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR
+   CONSEQUENTIAL DAMAGES ARISING OUT OF THE USE OF THIS SOFTWARE
+   AND ITS DOCUMENTATION, EVEN IF THE UNIVERSITY OF CALIFORNIA
+   HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+   THE UNIVERSITY OF CALIFORNIA SPECIFICALLY DISCLAIMS ANY
+   WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+   PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS IS"
+   BASIS, AND THE UNIVERSITY OF CALIFORNIA HAS NO OBLIGATION TO
+   PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR
+   MODIFICATIONS.
+*/
+
+#include "threads/synch.h"
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+
+static void waiters_insert (struct list *, struct thread *);
+static struct thread *waiters_pop (struct list *);
+
+/* Initializes semaphore SEMA to VALUE.  A semaphore is a
+   nonnegative integer along with two atomic operators for
+   manipulating it:
+
+   - down or "P": wait for the value to become positive, then
+     decrement it.
+
+   - up or "V": increment the value (and wake up one waiting
+     thread, if any).
+
+   Waiting threads are kept in order of priority, highest first,
+   and in order of arrival among equals, so that "up" wakes the
+   most important one in constant time. */
+void
+sema_init (struct semaphore *sema, unsigned value)
+{
+  ASSERT (sema != NULL);
+
+  sema->value = value;
+  list_init (&sema->waiters);
+}
+
+/* Down or "P" operation on a semaphore.  Waits for SEMA's value
+   to become positive and then atomically decrements it.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler.  This function may be called with
+   interrupts disabled, but if it sleeps then the next scheduled
+   thread will probably turn interrupts back on. */
+void
+sema_down (struct semaphore *sema)
+{
+  enum intr_level old_level;
+
+  ASSERT (sema != NULL);
+  ASSERT (!intr_context ());
+
+  old_level = intr_disable ();
+  while (sema->value == 0)
+    {
+      waiters_insert (&sema->waiters, thread_current ());
+      thread_block ();
+    }
+  sema->value--;
+  intr_set_level (old_level);
+}
+
+/* A thread waiting in sema_down_timeout(). */
+struct sema_timed_wait
+  {
+    struct thread *thread;      /* The waiting thread. */
+    struct semaphore *sema;     /* The semaphore it waits on. */
+  };
+
+/* Timer event function for sema_down_timeout().  Takes the
+   waiting thread off the semaphore's wait list, if it is still
+   on it, and wakes it up.  A thread that sema_up() has already
+   woken may since have been blocked for another reason, such as
+   its group running out of quota, and is left alone. */
+static void
+sema_timeout (void *w_)
+{
+  struct sema_timed_wait *w = w_;
+  struct thread *t = w->thread;
+
+  if (t->status == THREAD_BLOCKED && t->wait_list == &w->sema->waiters)
+    {
+      list_remove (&t->elem);
+      t->wait_list = NULL;
+      thread_unblock (t);
+    }
+}
+
+/* Down or "P" operation on a semaphore that gives up after
+   TICKS timer ticks.  Returns true if SEMA was decremented,
+   false if the wait timed out.  If TICKS <= 0, this is the same
+   as sema_try_down().
+
+   This function may sleep, so it must not be called within an
+   interrupt handler.  This function may be called with
+   interrupts disabled, but if it sleeps then the next scheduled
+   thread will probably turn interrupts back on. */
+bool
+sema_down_timeout (struct semaphore *sema, int64_t ticks)
+{
+  struct thread *cur = thread_current ();
+  struct sema_timed_wait w;
+  struct timer_event timeout;
+  enum intr_level old_level;
+  int64_t deadline;
+  bool success = true;
+
+  ASSERT (sema != NULL);
+  ASSERT (!intr_context ());
+
+  old_level = intr_disable ();
+  deadline = timer_ticks () + ticks;
+  w.thread = cur;
+  w.sema = sema;
+  timer_event_init (&timeout, sema_timeout, &w);
+  if (sema->value == 0 && ticks > 0)
+    timer_event_add (&timeout, deadline);
+  while (sema->value == 0)
+    {
+      if (timer_ticks () >= deadline)
+        {
+          success = false;
+          break;
+        }
+      waiters_insert (&sema->waiters, cur);
+      thread_block ();
+    }
+  if (success)
+    sema->value--;
+  timer_event_cancel (&timeout);
+  intr_set_level (old_level);
+
+  return success;
+}
+
+/* Down or "P" operation on a semaphore, but only if the
+   semaphore is not already 0.  Returns true if the semaphore is
+   decremented, false otherwise.
+
+   This function may be called from an interrupt handler. */
+bool
+sema_try_down (struct semaphore *sema)
+{
+  enum intr_level old_level;
+  bool success;
+
+  ASSERT (sema != NULL);
+
+  old_level = intr_disable ();
+  if (sema->value > 0)
+    {
+      sema->value--;
+      success = true;
+    }
+  else
+    success = false;
+  intr_set_level (old_level);
+
+  return success;
+}
+
+/* Up or "V" operation on a semaphore.  Increments SEMA's value
+   and wakes up the highest-priority thread of those waiting for
+   SEMA, if any.  If the woken thread has a higher priority than
+   the running thread, the running thread yields to it.
+
+   This function may be called from an interrupt handler. */
+void
+sema_up (struct semaphore *sema)
+{
+  enum intr_level old_level;
+
+  ASSERT (sema != NULL);
+
+  old_level = intr_disable ();
+  if (!list_empty (&sema->waiters))
+    thread_unblock (waiters_pop (&sema->waiters));
+  sema->value++;
+  intr_set_level (old_level);
+  thread_preempt ();
+}
+
+/* Returns true if thread A has a higher priority than B. */
+static bool
+higher_priority (const struct list_elem *a_, const struct list_elem *b_,
+                 void *aux UNUSED)
+{
+  const struct thread *a = list_entry (a_, struct thread, elem);
+  const struct thread *b = list_entry (b_, struct thread, elem);
+
+  return a->priority > b->priority;
+}
+
+/* Adds thread T to WAITERS, a list of threads in priority order,
+   behind any of equal priority, and records that T waits there.
+   Must be called with interrupts off. */
+static void
+waiters_insert (struct list *waiters, struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  list_insert_ordered (waiters, &t->elem, higher_priority, NULL);
+  t->wait_list = waiters;
+}
+
+/* Removes and returns the highest-priority thread in WAITERS,
+   which must not be empty.  Must be called with interrupts
+   off. */
+static struct thread *
+waiters_pop (struct list *waiters)
+{
+  struct thread *t;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  t = list_entry (list_pop_front (waiters), struct thread, elem);
+  t->wait_list = NULL;
+  return t;
+}
+
+/* Moves blocked thread T, whose priority has just changed, to
+   its new place in the list of threads it waits on, if any.
+   Called by the scheduler with interrupts off. */
+void
+synch_requeue (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (t->status == THREAD_BLOCKED);
+
+  if (t->wait_list != NULL)
+    {
+      list_remove (&t->elem);
+      waiters_insert (t->wait_list, t);
+    }
+}
+
+static void sema_test_helper (void *sema_);
+static void adopt_waiters (struct lock *);
+
+/* Self-test for semaphores that makes control "ping-pong"
+   between a pair of threads.  Insert calls to printf() to see
+   what's going on. */
+void
+sema_self_test (void)
+{
+  struct semaphore sema[2];
+  int i;
+
+  printf ("Testing semaphores...");
+  sema_init (&sema[0], 0);
+  sema_init (&sema[1], 0);
+  thread_create ("sema-test", PRI_DEFAULT, sema_test_helper, &sema);
+  for (i = 0; i < 10; i++)
+    {
+      sema_up (&sema[0]);
+      sema_down (&sema[1]);
+    }
+  printf ("done.\n");
+}
+
+/* Thread function used by sema_self_test(). */
+static void
+sema_test_helper (void *sema_)
+{
+  struct semaphore *sema = sema_;
+  int i;
+
+  for (i = 0; i < 10; i++)
+    {
+      sema_down (&sema[0]);
+      sema_up (&sema[1]);
+    }
+}
+
+/* Initializes LOCK.  A lock can be held by at most a single
+   thread at any given time.  Our locks are not "recursive", that
+   is, it is an error for the thread currently holding a lock to
+   try to acquire that lock.
+
+   A lock is a specialization of a semaphore with an initial
+   value of 1.  The difference between a lock and such a
+   semaphore is twofold.  First, a semaphore can have a value
+   greater than 1, but a lock can only be owned by a single
+   thread at a time.  Second, a semaphore does not have an owner,
+   meaning that one thread can "down" the semaphore and then
+   another one "up" it, but with a lock the same thread must both
+   acquire and release it.  When these restrictions prove
+   onerous, it's a good sign that a semaphore should be used,
+   instead of a lock. */
+void
+lock_init (struct lock *lock)
+{
+  ASSERT (lock != NULL);
+
+  lock->holder = NULL;
+  sema_init (&lock->semaphore, 1);
+}
+
+/* Acquires LOCK, sleeping until it becomes available if
+   necessary.  The lock must not already be held by the current
+   thread.
+
+   While we wait, our priority is donated to the holder, and
+   through it to whatever the holder is itself waiting for.  Once
+   we hold the lock, the threads still waiting for it donate to
+   us instead.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler.  This function may be called with
+   interrupts disabled, but interrupts will be turned back on if
+   we need to sleep. */
+void
+lock_acquire (struct lock *lock)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (lock != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!lock_held_by_current_thread (lock));
+
+  old_level = intr_disable ();
+  if (lock->holder != NULL)
+    {
+      cur->wait_lock = lock;
+      thread_donate (cur, lock->holder);
+    }
+  sema_down (&lock->semaphore);
+  cur->wait_lock = NULL;
+  thread_undonate (cur);
+  lock->holder = cur;
+  adopt_waiters (lock);
+  intr_set_level (old_level);
+}
+
+/* Like lock_acquire(), but gives up after TICKS timer ticks.
+   Returns true if LOCK was acquired, false if the wait timed
+   out.  Priority donated while waiting is withdrawn on timeout.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+bool
+lock_acquire_timeout (struct lock *lock, int64_t ticks)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+  bool success;
+
+  ASSERT (lock != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!lock_held_by_current_thread (lock));
+
+  old_level = intr_disable ();
+  if (lock->holder != NULL)
+    {
+      cur->wait_lock = lock;
+      thread_donate (cur, lock->holder);
+    }
+  success = sema_down_timeout (&lock->semaphore, ticks);
+  cur->wait_lock = NULL;
+  thread_undonate (cur);
+  if (success)
+    {
+      lock->holder = cur;
+      adopt_waiters (lock);
+    }
+  intr_set_level (old_level);
+
+  return success;
+}
+
+/* Makes the threads waiting for LOCK donate their priority to
+   LOCK's new holder. */
+static void
+adopt_waiters (struct lock *lock)
+{
+  struct list *waiters = &lock->semaphore.waiters;
+  struct list_elem *e;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (e = list_begin (waiters); e != list_end (waiters); e = list_next (e))
+    {
+      struct thread *t = list_entry (e, struct thread, elem);
+      if (t->donee == NULL)
+        thread_donate (t, lock->holder);
+    }
+}
+
+/* Tries to acquires LOCK and returns true if successful or false
+   on failure.  The lock must not already be held by the current
+   thread.
+
+   This function will not sleep, so it may be called within an
+   interrupt handler. */
+bool
+lock_try_acquire (struct lock *lock)
+{
+  bool success;
+
+  ASSERT (lock != NULL);
+  ASSERT (!lock_held_by_current_thread (lock));
+
+  success = sema_try_down (&lock->semaphore);
+  if (success)
+    lock->holder = thread_current ();
+  return success;
+}
+
+/* Releases LOCK, which must be owned by the current thread.
+   Priority donated by the threads waiting for LOCK is given up;
+   donations received through other locks we still hold remain.
+
+   An interrupt handler cannot acquire a lock, so it does not
+   make sense to try to release a lock within an interrupt
+   handler. */
+void
+lock_release (struct lock *lock)
+{
+  struct thread *cur = thread_current ();
+  struct list_elem *e, *next;
+  enum intr_level old_level;
+
+  ASSERT (lock != NULL);
+  ASSERT (lock_held_by_current_thread (lock));
+
+  old_level = intr_disable ();
+  for (e = list_begin (&cur->donors); e != list_end (&cur->donors); e = next)
+    {
+      struct thread *donor = list_entry (e, struct thread, donor_elem);
+
+      next = list_next (e);
+      if (donor->wait_lock == lock)
+        thread_undonate (donor);
+    }
+  lock->holder = NULL;
+  intr_set_level (old_level);
+  sema_up (&lock->semaphore);
+}
+
+/* Returns true if the current thread holds LOCK, false
+   otherwise.  (Note that testing whether some other thread holds
+   a lock would be racy.) */
+bool
+lock_held_by_current_thread (const struct lock *lock)
+{
+  ASSERT (lock != NULL);
+
+  return lock->holder == thread_current ();
+}
+
+/* Initializes condition variable COND.  A condition variable
+   allows one piece of code to signal a condition and cooperating
+   code to receive the signal and act upon it.
+
+   Waiting threads are queued on COND itself, in priority order.
+   Signaling does not wake a waiter, which would only block again
+   on the lock that the signaler holds.  Instead, the waiter is
+   moved straight onto the lock's wait queue ("wait morphing"),
+   to be woken when the lock is released, so that a broadcast
+   wakes the waiters one at a time rather than all at once. */
+void
+cond_init (struct condition *cond)
+{
+  ASSERT (cond != NULL);
+
+  list_init (&cond->waiters);
+}
+
+/* Atomically releases LOCK and waits for COND to be signaled by
+   some other piece of code.  After COND is signaled, LOCK is
+   reacquired before returning.  LOCK must be held before calling
+   this function.
+
+   The monitor implemented by this function is "Mesa" style, not
+   "Hoare" style, that is, sending and receiving a signal are not
+   an atomic operation.  Thus, typically the caller must recheck
+   the condition after the wait completes and, if necessary, wait
+   again.
+
+   A given condition variable is associated with only a single
+   lock, but one lock may be associated with any number of
+   condition variables.  That is, there is a one-to-many mapping
+   from locks to condition variables.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler.  This function may be called with
+   interrupts disabled, but interrupts will be turned back on if
+   we need to sleep. */
+void
+cond_wait (struct condition *cond, struct lock *lock)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (cond != NULL);
+  ASSERT (lock != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (lock_held_by_current_thread (lock));
+
+  /* With interrupts off, releasing LOCK cannot yield before we
+     are on COND's queue. */
+  old_level = intr_disable ();
+  waiters_insert (&cond->waiters, cur);
+  lock_release (lock);
+  thread_block ();
+
+  /* We were moved to LOCK's queue and woken by its release.  The
+     lock is most likely free, but a thread that was not waiting
+     may have taken it in the meantime, so acquire it the usual
+     way.  Any donation made while we were queued on LOCK was
+     withdrawn when it was released. */
+  ASSERT (cur->donee == NULL);
+  cur->wait_lock = NULL;
+  lock_acquire (lock);
+  intr_set_level (old_level);
+}
+
+/* Moves the highest-priority thread waiting on COND to the wait
+   queue of LOCK, which the caller holds, as if the thread had
+   blocked in lock_acquire(). */
+static void
+cond_morph (struct condition *cond, struct lock *lock)
+{
+  struct thread *t = waiters_pop (&cond->waiters);
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  waiters_insert (&lock->semaphore.waiters, t);
+  t->wait_lock = lock;
+  thread_donate (t, lock->holder);
+}
+
+/* If any threads are waiting on COND (protected by LOCK), then
+   this function signals the highest-priority one to wake up from
+   its wait.  It will run once it can reacquire LOCK, which must
+   be held before calling this function.
+
+   An interrupt handler cannot acquire a lock, so it does not
+   make sense to try to signal a condition variable within an
+   interrupt handler. */
+void
+cond_signal (struct condition *cond, struct lock *lock)
+{
+  enum intr_level old_level;
+
+  ASSERT (cond != NULL);
+  ASSERT (lock != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (lock_held_by_current_thread (lock));
+
+  old_level = intr_disable ();
+  if (!list_empty (&cond->waiters))
+    cond_morph (cond, lock);
+  intr_set_level (old_level);
+}
+
+/* Wakes up all threads, if any, waiting on COND (protected by
+   LOCK), in priority order, each as LOCK becomes free.  LOCK
+   must be held before calling this function.
+
+   An interrupt handler cannot acquire a lock, so it does not
+   make sense to try to signal a condition variable within an
+   interrupt handler. */
+void
+cond_broadcast (struct condition *cond, struct lock *lock)
+{
+  enum intr_level old_level;
+
+  ASSERT (cond != NULL);
+  ASSERT (lock != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (lock_held_by_current_thread (lock));
+
+  old_level = intr_disable ();
+  while (!list_empty (&cond->waiters))
+    cond_morph (cond, lock);
+  intr_set_level (old_level);
+}
+
+/* Initializes readers-writer lock RW.  Any number of readers may
+   hold RW at once, or a single writer.  A waiting writer keeps
+   new readers out, so that a steady stream of readers cannot
+   starve it.  Readers do not donate priority to each other or
+   to a writer.
+
+   This is built on a lock and condition variables, so it may
+   not be used from an interrupt handler. */
+void
+rwlock_init (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  lock_init (&rw->lock);
+  cond_init (&rw->can_read);
+  cond_init (&rw->can_write);
+  rw->readers = 0;
+  rw->writers_waiting = 0;
+  rw->writer = false;
+}
+
+/* Acquires RW for reading, sleeping while a writer holds it or
+   waits for it. */
+void
+rwlock_acquire_read (struct rwlock *rw)
+{
+  lock_acquire (&rw->lock);
+  while (rw->writer || rw->writers_waiting > 0)
+    cond_wait (&rw->can_read, &rw->lock);
+  rw->readers++;
+  lock_release (&rw->lock);
+}
+
+/* Releases RW, which the caller holds for reading. */
+void
+rwlock_release_read (struct rwlock *rw)
+{
+  lock_acquire (&rw->lock);
+  ASSERT (rw->readers > 0);
+  if (--rw->readers == 0 && rw->writers_waiting > 0)
+    cond_signal (&rw->can_write, &rw->lock);
+  lock_release (&rw->lock);
+}
+
+/* Acquires RW for writing, sleeping until no one else holds
+   it. */
+void
+rwlock_acquire_write (struct rwlock *rw)
+{
+  lock_acquire (&rw->lock);
+  rw->writers_waiting++;
+  while (rw->writer || rw->readers > 0)
+    cond_wait (&rw->can_write, &rw->lock);
+  rw->writers_waiting--;
+  rw->writer = true;
+  lock_release (&rw->lock);
+}
+
+/* Releases RW, which the caller holds for writing, to the next
+   waiting writer if there is one, otherwise to all waiting
+   readers. */
+void
+rwlock_release_write (struct rwlock *rw)
+{
+  lock_acquire (&rw->lock);
+  ASSERT (rw->writer);
+  rw->writer = false;
+  if (rw->writers_waiting > 0)
+    cond_signal (&rw->can_write, &rw->lock);
+  else
+    cond_broadcast (&rw->can_read, &rw->lock);
+  lock_release (&rw->lock);
+}
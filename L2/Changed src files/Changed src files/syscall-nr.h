@@ -0,0 +1,54 @@
+#ifndef __LIB_SYSCALL_NR_H
+#define __LIB_SYSCALL_NR_H
+
+/* System call numbers. */
+enum 
+  {
+    /* Projects 2 and later. */
+    SYS_HALT,                   /* Halt the operating system. */
+    SYS_EXIT,                   /* Terminate this process. */
+    SYS_EXEC,                   /* Start another process. */
+    SYS_WAIT,                   /* Wait for a child process to die. */
+    SYS_CREATE,                 /* Create a file. */
+    SYS_REMOVE,                 /* Delete a file. */
+    SYS_OPEN,                   /* Open a file. */
+    SYS_FILESIZE,               /* Obtain a file's size. */
+    SYS_READ,                   /* Read from a file. */
+    SYS_WRITE,                  /* Write to a file. */
+    SYS_SEEK,                   /* Change position in a file. */
+    SYS_TELL,                   /* Report current position in a file. */
+    SYS_CLOSE,                  /* Close a file. */
+
+    /* Project 3 and optionally project 4. */
+    SYS_MMAP,                   /* Map a file into memory. */
+    SYS_MUNMAP,                 /* Remove a memory mapping. */
+
+    /* Project 4 only. */
+    SYS_CHDIR,                  /* Change the current directory. */
+    SYS_MKDIR,                  /* Create a directory. */
+    SYS_READDIR,                /* Reads a directory entry. */
+    SYS_ISDIR,                  /* Tests if a fd represents a directory. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* Scheduler extensions. */
+    SYS_NICE,                   /* Adjust this process's nice value. */
+    SYS_GETPRIORITY,            /* Obtain this process's priority. */
+    SYS_SLEEP_MS,               /* Sleep for a number of milliseconds. */
+    SYS_SCHED_DEADLINE,         /* Join the earliest-deadline-first class. */
+    SYS_SCHED_YIELD,            /* Finish the current EDF job. */
+    SYS_TICKETS,                /* Get or set stride scheduler tickets. */
+    SYS_SETGROUP,               /* Move this process to a process group. */
+    SYS_GROUP_QUOTA,            /* Limit a process group's CPU time. */
+    SYS_FUTEX_WAIT,             /* Wait on a user memory word. */
+    SYS_FUTEX_WAKE,             /* Wake waiters on a user memory word. */
+    SYS_THREAD_CREATE,          /* Start a thread in this process. */
+    SYS_THREAD_JOIN,            /* Wait for a thread to exit. */
+    SYS_THREAD_EXIT,            /* End the calling thread. */
+    SYS_SYSSTATS,               /* Obtain system call statistics. */
+    SYS_READV,                  /* Read from a file into several buffers. */
+    SYS_WRITEV,                 /* Write several buffers to a file. */
+    SYS_URING_SETUP,            /* Register submission/completion rings. */
+    SYS_URING_ENTER             /* Run submitted operations. */
+  };
+
+#endif /* lib/syscall-nr.h */
@@ -0,0 +1,28 @@
+#ifndef __LIB_SYSCALL_STATS_H
+#define __LIB_SYSCALL_STATS_H
+
+/* System call statistics, as returned by the sysstats system
+   call: one struct syscall_stats per system call number. */
+
+/* Scopes for sysstats. */
+#define SYSSTATS_SYSTEM 0       /* All processes since boot. */
+#define SYSSTATS_PROCESS 1      /* The calling process. */
+
+/* Latency histogram.  Bucket N counts calls that took
+   2**(SYSCALL_HIST_SHIFT + N) to 2**(SYSCALL_HIST_SHIFT + N + 1)
+   - 1 time-stamp counter cycles, except that the first bucket
+   also counts all shorter calls and the last all longer ones. */
+#define SYSCALL_HIST_CNT 16
+#define SYSCALL_HIST_SHIFT 8
+
+/* Statistics for one system call.  Calls that do not return,
+   such as exit, are not counted. */
+struct syscall_stats
+  {
+    long long calls;                    /* # of calls. */
+    unsigned long long cycles;          /* Total time in TSC cycles. */
+    unsigned long long us;              /* CYCLES in microseconds. */
+    unsigned hist[SYSCALL_HIST_CNT];    /* Latency histogram. */
+  };
+
+#endif /* lib/syscall-stats.h */
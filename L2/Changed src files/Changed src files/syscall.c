@@ -1,141 +1,499 @@
 #include <stdio.h>
 #include <syscall-nr.h>
+#include <syscall-stats.h>
+#include <iovec.h>
+#include <uring.h>
+#include <limits.h>
 #include <user/syscall.h>
 #include <string.h>
 #include <ctype.h>
 #include <devices/shutdown.h>
 #include <devices/input.h>
+#include <devices/timer.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "threads/synch.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/tsc.h"
 #include "userprog/pagedir.h"
 #include "userprog/syscall.h"
 #include "userprog/process.h"
+#include "userprog/futex.h"
+#include "userprog/uaccess.h"
 #include <kernel/console.h>
 #include <filesys/filesys.h>
 #include <filesys/file.h>
 
 #define MAX_ARGS 3
 
-struct lock filesys_lock;
-
 static void syscall_handler (struct intr_frame *);
-void validate_pointer (void *ptr);
+static char *copy_string (const char *ustr);
+static struct file *fd_pin (int fd);
+static void fd_unpin (int fd, struct file *);
 void get_arguments (int *esp, int *args, int count);
+int nice (int increment);
+int getpriority (void);
+void sleep_ms (unsigned ms);
+int sched_deadline (unsigned period_ms, unsigned runtime_ms,
+                    unsigned deadline_ms);
+void sched_yield (void);
+int tickets (int new_tickets);
+int setgroup (int group);
+int group_quota (int group, unsigned quota_ms, unsigned period_ms);
+int futex_wait (int *addr, int expected, int timeout_ms);
+int futex_wake (int *addr, int n);
+tid_t uthread_create (void (*start) (void), void *func, void *aux);
+int uthread_join (tid_t tid);
+void uthread_exit (void) NO_RETURN;
+int sysstats (int scope, void *buffer, unsigned size);
+int readv (int fd, const struct iovec *, int iovcnt);
+int writev (int fd, const struct iovec *, int iovcnt);
+int uring_setup (struct uring *);
+int uring_enter (unsigned to_submit);
+
+/* Types of system call arguments.  syscall_handler() checks each
+   argument according to its type before it calls the handler.
+   Handlers access user memory only through uaccess.h. */
+enum syscall_arg
+  {
+    ARG_INT,                    /* Any integer. */
+    ARG_FD,                     /* File descriptor, 0...MAX_FD - 1. */
+    ARG_PTR,                    /* User address. */
+    ARG_STR,                    /* Null-terminated user string. */
+    ARG_BUF                     /* User buffer, whose size in bytes is
+                                   the next argument. */
+  };
+
+/* Types of system call return values. */
+enum syscall_ret
+  {
+    RET_VOID,                   /* None; EAX is left alone. */
+    RET_INT                     /* Integer, pointer or bool. */
+  };
+
+/* A system call handler.  Takes the arguments that
+   check_arguments() has checked and returns the value for EAX.
+   Each is a thin wrapper around the function that does the
+   work, so that the table can call them all through one type. */
+typedef uint32_t syscall_func (const int *args);
+
+/* A system call. */
+struct syscall
+  {
+    const char *name;           /* Name, for statistics. */
+    syscall_func *func;         /* Handler. */
+    enum syscall_ret ret;       /* Type of return value. */
+    int argc;                   /* Number of arguments. */
+    enum syscall_arg args[MAX_ARGS]; /* Type of each argument. */
+  };
+
+#define SYSCALL(NR, NAME, FUNC, RET, ARGC, ...) \
+  [NR] = {NAME, FUNC, RET, ARGC, {__VA_ARGS__}}
+
+/* System call handlers for syscall_table. */
+static uint32_t
+sys_halt (const int *args UNUSED)
+{
+  shutdown_power_off ();
+  return 0;
+}
+
+static uint32_t
+sys_exit (const int *args)
+{
+  exit (args[0]);
+  return 0;
+}
+
+static uint32_t
+sys_exec (const int *args)
+{
+  return exec ((const char *) args[0]);
+}
+
+static uint32_t
+sys_wait (const int *args)
+{
+  return wait (args[0]);
+}
+
+static uint32_t
+sys_create (const int *args)
+{
+  return create ((const char *) args[0], args[1]);
+}
+
+static uint32_t
+sys_remove (const int *args)
+{
+  return filesys_remove ((const char *) args[0]);
+}
+
+static uint32_t
+sys_open (const int *args)
+{
+  return open ((const char *) args[0]);
+}
+
+static uint32_t
+sys_filesize (const int *args)
+{
+  return filesize (args[0]);
+}
+
+static uint32_t
+sys_read (const int *args)
+{
+  return read (args[0], (void *) args[1], args[2]);
+}
+
+static uint32_t
+sys_write (const int *args)
+{
+  return write (args[0], (const void *) args[1], args[2]);
+}
+
+static uint32_t
+sys_seek (const int *args)
+{
+  seek (args[0], args[1]);
+  return 0;
+}
+
+static uint32_t
+sys_tell (const int *args)
+{
+  return tell (args[0]);
+}
+
+static uint32_t
+sys_close (const int *args)
+{
+  close (args[0]);
+  return 0;
+}
+
+static uint32_t
+sys_nice (const int *args)
+{
+  return nice (args[0]);
+}
+
+static uint32_t
+sys_getpriority (const int *args UNUSED)
+{
+  return getpriority ();
+}
+
+static uint32_t
+sys_sleep_ms (const int *args)
+{
+  sleep_ms (args[0]);
+  return 0;
+}
+
+static uint32_t
+sys_sched_deadline (const int *args)
+{
+  return sched_deadline (args[0], args[1], args[2]);
+}
+
+static uint32_t
+sys_sched_yield (const int *args UNUSED)
+{
+  sched_yield ();
+  return 0;
+}
+
+static uint32_t
+sys_tickets (const int *args)
+{
+  return tickets (args[0]);
+}
+
+static uint32_t
+sys_setgroup (const int *args)
+{
+  return setgroup (args[0]);
+}
+
+static uint32_t
+sys_group_quota (const int *args)
+{
+  return group_quota (args[0], args[1], args[2]);
+}
+
+static uint32_t
+sys_futex_wait (const int *args)
+{
+  return futex_wait ((int *) args[0], args[1], args[2]);
+}
+
+static uint32_t
+sys_futex_wake (const int *args)
+{
+  return futex_wake ((int *) args[0], args[1]);
+}
+
+static uint32_t
+sys_thread_create (const int *args)
+{
+  return uthread_create ((void (*) (void)) args[0],
+                         (void *) args[1], (void *) args[2]);
+}
+
+static uint32_t
+sys_thread_join (const int *args)
+{
+  return uthread_join (args[0]);
+}
+
+static uint32_t
+sys_thread_exit (const int *args UNUSED)
+{
+  uthread_exit ();
+}
+
+static uint32_t
+sys_sysstats (const int *args)
+{
+  return sysstats (args[0], (void *) args[1], args[2]);
+}
+
+static uint32_t
+sys_readv (const int *args)
+{
+  return readv (args[0], (const struct iovec *) args[1], args[2]);
+}
+
+static uint32_t
+sys_writev (const int *args)
+{
+  return writev (args[0], (const struct iovec *) args[1], args[2]);
+}
+
+static uint32_t
+sys_uring_setup (const int *args)
+{
+  return uring_setup ((struct uring *) args[0]);
+}
+
+static uint32_t
+sys_uring_enter (const int *args)
+{
+  return uring_enter (args[0]);
+}
+
+
+/* System calls, indexed by number.  Numbers without an entry are
+   not implemented. */
+static const struct syscall syscall_table[] =
+  {
+    SYSCALL (SYS_HALT, "halt", sys_halt, RET_VOID, 0),
+    SYSCALL (SYS_EXIT, "exit", sys_exit, RET_VOID, 1, ARG_INT),
+    SYSCALL (SYS_EXEC, "exec", sys_exec, RET_INT, 1, ARG_STR),
+    SYSCALL (SYS_WAIT, "wait", sys_wait, RET_INT, 1, ARG_INT),
+    SYSCALL (SYS_CREATE, "create", sys_create, RET_INT, 2,
+             ARG_STR, ARG_INT),
+    SYSCALL (SYS_REMOVE, "remove", sys_remove, RET_INT, 1, ARG_STR),
+    SYSCALL (SYS_OPEN, "open", sys_open, RET_INT, 1, ARG_STR),
+    SYSCALL (SYS_FILESIZE, "filesize", sys_filesize, RET_INT, 1, ARG_FD),
+    SYSCALL (SYS_READ, "read", sys_read, RET_INT, 3,
+             ARG_FD, ARG_BUF, ARG_INT),
+    SYSCALL (SYS_WRITE, "write", sys_write, RET_INT, 3,
+             ARG_FD, ARG_BUF, ARG_INT),
+    SYSCALL (SYS_SEEK, "seek", sys_seek, RET_VOID, 2, ARG_FD, ARG_INT),
+    SYSCALL (SYS_TELL, "tell", sys_tell, RET_INT, 1, ARG_FD),
+    SYSCALL (SYS_CLOSE, "close", sys_close, RET_VOID, 1, ARG_FD),
+    SYSCALL (SYS_NICE, "nice", sys_nice, RET_INT, 1, ARG_INT),
+    SYSCALL (SYS_GETPRIORITY, "getpriority", sys_getpriority, RET_INT, 0),
+    SYSCALL (SYS_SLEEP_MS, "sleep_ms", sys_sleep_ms, RET_VOID, 1, ARG_INT),
+    SYSCALL (SYS_SCHED_DEADLINE, "sched_deadline", sys_sched_deadline,
+             RET_INT, 3, ARG_INT, ARG_INT, ARG_INT),
+    SYSCALL (SYS_SCHED_YIELD, "sched_yield", sys_sched_yield, RET_VOID, 0),
+    SYSCALL (SYS_TICKETS, "tickets", sys_tickets, RET_INT, 1, ARG_INT),
+    SYSCALL (SYS_SETGROUP, "setgroup", sys_setgroup, RET_INT, 1, ARG_INT),
+    SYSCALL (SYS_GROUP_QUOTA, "group_quota", sys_group_quota, RET_INT, 3,
+             ARG_INT, ARG_INT, ARG_INT),
+    SYSCALL (SYS_FUTEX_WAIT, "futex_wait", sys_futex_wait, RET_INT, 3,
+             ARG_PTR, ARG_INT, ARG_INT),
+    SYSCALL (SYS_FUTEX_WAKE, "futex_wake", sys_futex_wake, RET_INT, 2,
+             ARG_PTR, ARG_INT),
+    SYSCALL (SYS_THREAD_CREATE, "thread_create", sys_thread_create,
+             RET_INT, 3, ARG_INT, ARG_INT, ARG_INT),
+    SYSCALL (SYS_THREAD_JOIN, "thread_join", sys_thread_join, RET_INT, 1,
+             ARG_INT),
+    SYSCALL (SYS_THREAD_EXIT, "thread_exit", sys_thread_exit, RET_VOID, 0),
+    SYSCALL (SYS_SYSSTATS, "sysstats", sys_sysstats, RET_INT, 3,
+             ARG_INT, ARG_BUF, ARG_INT),
+    SYSCALL (SYS_READV, "readv", sys_readv, RET_INT, 3,
+             ARG_FD, ARG_PTR, ARG_INT),
+    SYSCALL (SYS_WRITEV, "writev", sys_writev, RET_INT, 3,
+             ARG_FD, ARG_PTR, ARG_INT),
+    SYSCALL (SYS_URING_SETUP, "uring_setup", sys_uring_setup, RET_INT, 1,
+             ARG_PTR),
+    SYSCALL (SYS_URING_ENTER, "uring_enter", sys_uring_enter, RET_INT, 1,
+             ARG_INT),
+  };
+
+/* Number of entries in syscall_table. */
+#define SYSCALL_CNT ((int) (sizeof syscall_table / sizeof *syscall_table))
+
+/* Statistics for all processes, indexed by system call number.
+   Each process keeps its own in its `syscall_stats'. */
+static struct syscall_stats syscall_stats[SYSCALL_CNT];
 
 void
-syscall_init (void) 
+syscall_init (void)
 {
+  futex_init ();
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
 }
-/*The get_arguments function retrieves the arguments from the stack for the given system call. The validate_pointer function checks if the pointer is a valid user address and if it points to a page in the current thread's page directory.
 
-The exit function sets the exit status for the current thread and signals its completion. It also prints the exit status and terminates the current thread.*/
+/* Checks the arguments in ARGS against the types that SC gives
+   them, killing the process if one is invalid.  Copies a string
+   argument into a kernel page and replaces its address in ARGS
+   by the copy's, which release_arguments() frees.  Buffers are
+   left to the handlers, which copy them in pieces. */
 static void
-syscall_handler (struct intr_frame *f) 
+check_arguments (const struct syscall *sc, int *args)
 {
-  int args[MAX_ARGS];
-  lock_init (&filesys_lock);
-  validate_pointer (f->esp);
-  int *sp = (int *)f->esp;
-  struct thread *cur = thread_current ();
+  int i;
 
-  switch (*sp)
-  {
-   case SYS_HALT:
-      shutdown_power_off ();
-
-   case SYS_EXIT:
-      get_arguments (sp, &args[0], 1); 
-      exit ((int)args[0]);
-      break;
-
-   case SYS_EXEC:
-      get_arguments (sp, &args[0], 1);
-      f->eax = exec ((const char *)pagedir_get_page (cur->pagedir,
-					(const void *) args[0]));
-      break;
-
-   case SYS_WAIT:
-      get_arguments (sp, &args[0], 1);
-      f->eax = wait ((pid_t)args[0]);
-      break;
-    
-   case SYS_WRITE:
-      get_arguments (sp, &args[0], 3);
-      args[1] = (int)pagedir_get_page (cur->pagedir, (const void *)args[1]);
-      f->eax = write ((int)args[0], (void *)args[1], (unsigned)args[2]);
-      break;
-    
-   case SYS_READ:
-      get_arguments (sp, &args[0], 3);
-      f->eax = read ((int)args[0], (void *)args[1], (unsigned)args[2]);
-      break;
-
-   case SYS_CREATE:
-      get_arguments (sp, &args[0], 2);
-      args[0] =(int) pagedir_get_page (cur->pagedir, (const void *)args[0]);
-      f->eax = create ((char *)args[0], (unsigned) args[1]);
-      break;
-
-    case SYS_REMOVE:
-       get_arguments (sp, &args[0], 1);
-       char *file_to_close = (char *)pagedir_get_page (cur->pagedir,
-					(const void *)args[0]);
-       lock_acquire (&filesys_lock);
-       f->eax = filesys_remove (file_to_close);
-       if (lock_held_by_current_thread (&filesys_lock))
-         lock_release (&filesys_lock);
-       break;
-
-    case SYS_OPEN:
-       get_arguments (sp, &args[0], 1);
-       f->eax = open ((char *)args[0]);
-       break; 
-  
-    case SYS_FILESIZE:
-       get_arguments (sp, &args[0], 1);
-       f->eax = filesize ((int)args[0]);
-       break;
-
-    case SYS_CLOSE:
-       get_arguments (sp, &args[0], 1);
-       args[0] = (int)pagedir_get_page (cur->pagedir, (const void *)args[0]);
-       close ((int)args[0]);
-       break;       
-
-    case SYS_TELL:
-       get_arguments (sp, &args[0], 1);
-       f->eax = tell ((int)args[0]);
-       break;
-
-    case SYS_SEEK:
-       get_arguments (sp, &args[0], 2);
-       seek ((int)args[0], (unsigned)args[1]);
-       break; 
-  }
+  for (i = 0; i < sc->argc; i++)
+    switch (sc->args[i])
+      {
+      case ARG_INT:
+      case ARG_STR:
+      case ARG_BUF:
+        break;
+
+      case ARG_FD:
+        if (args[i] < 0 || args[i] >= MAX_FD)
+          exit (-1);
+        break;
+
+      case ARG_PTR:
+        if (!is_user_vaddr ((void *) args[i]))
+          exit (-1);
+        break;
+      }
+
+  /* Strings last, so that no copy is leaked if another argument
+     kills the process. */
+  for (i = 0; i < sc->argc; i++)
+    if (sc->args[i] == ARG_STR)
+      args[i] = (int) copy_string ((const char *) args[i]);
 }
 
-void
-get_arguments (int *esp, int *args, int count)
+/* Frees the copies of SC's string arguments in ARGS. */
+static void
+release_arguments (const struct syscall *sc, int *args)
 {
   int i;
-  for (i = 0; i < count; i++)
-  {
-    int *next = ((esp + i) + 1);
-    validate_pointer (next);
-    args[i] = *next;
-  }
+
+  for (i = 0; i < sc->argc; i++)
+    if (sc->args[i] == ARG_STR)
+      palloc_free_page ((void *) args[i]);
 }
 
-void
-validate_pointer (void *ptr)
+/* Returns a copy of user string USTR in a new kernel page.
+   Kills the process if USTR is not mapped user memory or does
+   not fit in a page. */
+static char *
+copy_string (const char *ustr)
+{
+  char *kstr = palloc_get_page (0);
+  int len;
+
+  if (kstr == NULL)
+    exit (-1);
+  len = strncpy_from_user (kstr, ustr, PGSIZE);
+  if (len < 0 || len == PGSIZE)
+    {
+      palloc_free_page (kstr);
+      exit (-1);
+    }
+  return kstr;
+}
+
+/* Checks ARGS, the arguments for system call SC, and calls its
+   handler.  Returns the handler's result, or 0 if it has none. */
+static uint32_t
+invoke (const struct syscall *sc, int *args)
 {
-  if (!is_user_vaddr (ptr)) 
+  uint32_t retval;
+
+  check_arguments (sc, args);
+  retval = sc->func (args);
+  release_arguments (sc, args);
+  return sc->ret == RET_INT ? retval : 0;
+}
+
+/* Adds a call that took CYCLES to S. */
+static void
+account (struct syscall_stats *s, uint64_t cycles)
+{
+  int bucket = 63 - __builtin_clzll (cycles | 1) - SYSCALL_HIST_SHIFT;
+
+  if (bucket < 0)
+    bucket = 0;
+  else if (bucket >= SYSCALL_HIST_CNT)
+    bucket = SYSCALL_HIST_CNT - 1;
+  s->calls++;
+  s->cycles += cycles;
+  s->hist[bucket]++;
+}
+
+/*The get_arguments function retrieves the arguments from the stack for the given system call. It copies them with copy_from_user(), which fails instead of faulting if they are not in mapped user memory.
+
+The exit function sets the exit status for the current thread and signals its completion. It also prints the exit status and terminates the current thread.*/
+static void
+syscall_handler (struct intr_frame *f)
+{
+  int args[MAX_ARGS] = {0, 0, 0};
+  const struct syscall *sc;
+  struct process *p;
+  enum intr_level old_level;
+  uint64_t start, cycles;
+  uint32_t retval;
+  int nr;
+
+  thread_enter_kernel ();
+  start = rdtsc ();
+  if (!copy_from_user (&nr, f->esp, sizeof nr))
     exit (-1);
-  if  ((pagedir_get_page (thread_current ()->pagedir, ptr) == NULL))
+  if (nr < 0 || nr >= SYSCALL_CNT || syscall_table[nr].func == NULL)
+    exit (-1);
+  sc = &syscall_table[nr];
+  get_arguments (f->esp, args, sc->argc);
+  retval = invoke (sc, args);
+  if (sc->ret != RET_VOID)
+    f->eax = retval;
+
+  /* A process makes its first call before it can have a second
+     thread, so the allocation cannot race. */
+  p = thread_current ()->process;
+  if (p->syscall_stats == NULL)
+    p->syscall_stats = calloc (SYSCALL_CNT, sizeof *p->syscall_stats);
+
+  cycles = rdtsc () - start;
+  old_level = intr_disable ();
+  account (&syscall_stats[nr], cycles);
+  if (p->syscall_stats != NULL)
+    account (&p->syscall_stats[nr], cycles);
+  intr_set_level (old_level);
+
+  process_check_killed ();
+  thread_enter_user ();
+}
+
+void
+get_arguments (int *esp, int *args, int count)
+{
+  if (!copy_from_user (args, esp + 1, count * sizeof *args))
     exit (-1);
 }
 
@@ -146,61 +504,186 @@ exit (int status)
     If the current thread exits, then it should be removed from its
     parent's child list. */
   struct thread *cur = thread_current ();
-  cur->md->exit_status = status;
-  sema_up (&cur->md->completed);
+
+  /* The last thread to leave hands the process's metadata over
+     to our parent.  Our other threads must leave too. */
+  cur->process->md->exit_status = status;
+  process_kill_siblings ();
   printf ("%s: exit(%d)\n", cur->name, status);
   thread_exit ();
 }
 
+/* File system calls.  The file system does its own locking, per
+   inode and for the directory (see filesys.c), so these take no
+   lock around it.  A call that uses an open file pins it with
+   fd_pin() so that a close() by another thread cannot free it. */
+
 bool
 create (const char *file_name, unsigned size)
 {
   int return_value;
   if (file_name == NULL)
     exit (-1);    
-  lock_acquire (&filesys_lock);
   return_value = filesys_create (file_name, size);
-  lock_release (&filesys_lock);
   return return_value;
 }
 int
 open (const char *file)
 {
   struct thread *cur = thread_current ();
-  validate_pointer ((void *)file);
-  if (file == NULL)
-    exit (-1);
   if (strcmp (file, "") == 0)
     return -1;
-  lock_acquire (&filesys_lock);
   struct file *open_file = filesys_open (file); 
-  if (lock_held_by_current_thread (&filesys_lock))
-     lock_release (&filesys_lock);
   if (open_file == NULL)
     return -1;
-  if (file_get_inode (open_file) == file_get_inode(cur->md->exec_file))
+  if (file_get_inode (open_file)
+      == file_get_inode (cur->process->md->exec_file))
       file_deny_write (open_file);
   struct file **fd_array = cur->fd;
   int k;
+  /* The file table is shared with our other threads.  A slot
+     closed while still pinned is not free yet. */
+  lock_acquire (&cur->process->lock);
   for (k = 2; k < MAX_FD; k++)
   { 
-    if (fd_array[k] == NULL)
+    if (fd_array[k] == NULL && cur->process->fd_pins[k] == 0)
     {
      fd_array[k] = open_file;
      break;
     }
   }
+  lock_release (&cur->process->lock);
    return k;
 }  
 
+/* Transfers of this many bytes or fewer go through a bounce
+   buffer on the stack instead of a page. */
+#define SMALL_BOUNCE 128
+
+/* A kernel buffer that user data passes through on its way to or
+   from the file system or the console, which cannot recover from
+   a fault part way through. */
+struct bounce
+  {
+    uint8_t *buf;               /* SMALL or a page. */
+    unsigned size;              /* Size of BUF in bytes. */
+    uint8_t small[SMALL_BOUNCE]; /* Storage for small transfers. */
+  };
+
+/* Initializes B for a transfer of SIZE bytes in total.  Returns
+   false if memory is short. */
+static bool
+bounce_init (struct bounce *b, unsigned size)
+{
+  if (size <= sizeof b->small)
+    {
+      b->buf = b->small;
+      b->size = sizeof b->small;
+    }
+  else
+    {
+      b->buf = palloc_get_page (0);
+      if (b->buf == NULL)
+        return false;
+      b->size = PGSIZE;
+    }
+  return true;
+}
+
+/* Frees B's buffer. */
+static void
+bounce_free (struct bounce *b)
+{
+  if (b->buf != b->small)
+    palloc_free_page (b->buf);
+}
+
+/* Writes the SIZE bytes in BUF to FILE, or to the console if FILE
+   is null.  Returns the number of bytes written. */
+static int
+bounce_flush (struct file *file, const uint8_t *buf, unsigned size)
+{
+  if (file != NULL)
+    return file_write (file, buf, size);
+  putbuf ((const char *) buf, size);
+  return size;
+}
+
+/* Reads up to SIZE bytes from FILE into user buffer UBUF and
+   returns the number of bytes read, or -1 if memory is short.
+   The data goes through a bounce buffer a page at a time.  If
+   UBUF is not writable user memory, kills the process if FATAL,
+   otherwise returns -1. */
+static int
+read_to_user (struct file *file, void *ubuf, unsigned size, bool fatal)
+{
+  struct bounce b;
+  unsigned done = 0;
+
+  if (!bounce_init (&b, size))
+    return -1;
+  while (done < size)
+    {
+      unsigned chunk = size - done < b.size ? size - done : b.size;
+      off_t n = file_read (file, b.buf, chunk);
+
+      if (!copy_to_user ((uint8_t *) ubuf + done, b.buf, n))
+        {
+          bounce_free (&b);
+          if (fatal)
+            exit (-1);
+          return -1;
+        }
+      done += n;
+      if ((unsigned) n < chunk)
+        break;
+    }
+  bounce_free (&b);
+  return done;
+}
+
+/* Writes SIZE bytes from user buffer UBUF to FILE, or to the
+   console if FILE is null, through a bounce buffer as in
+   read_to_user().  Returns the number of bytes written, or -1 if
+   memory is short.  If UBUF is not readable user memory, kills
+   the process if FATAL, otherwise returns -1. */
+static int
+write_from_user (struct file *file, const void *ubuf, unsigned size,
+                 bool fatal)
+{
+  struct bounce b;
+  unsigned done = 0;
+
+  if (!bounce_init (&b, size))
+    return -1;
+  while (done < size)
+    {
+      unsigned chunk = size - done < b.size ? size - done : b.size;
+      int n;
+
+      if (!copy_from_user (b.buf, (const uint8_t *) ubuf + done, chunk))
+        {
+          bounce_free (&b);
+          if (fatal)
+            exit (-1);
+          return -1;
+        }
+      n = bounce_flush (file, b.buf, chunk);
+      done += n;
+      if ((unsigned) n < chunk)
+        break;
+    }
+  bounce_free (&b);
+  return done;
+}
+
 int
 read (int fd, void *_buffer, unsigned size)
 {
   struct thread *cur = thread_current ();
   char *buffer = (char *)_buffer;
-  validate_pointer (buffer);
   int retval = -1;
-  if (fd == 1 || fd < 0 || fd > MAX_FD)
+  if (fd == 1)
     exit (-1); 
   if (fd == 0)
   {
@@ -208,23 +691,22 @@ read (int fd, void *_buffer, unsigned size)
     unsigned i = 0;
     while ((c = input_getc ())!= '\n')
     {
-      buffer[i] = c; 
+      if (!copy_to_user (buffer + i, &c, 1))
+        exit (-1);
       i++;
       if (i == size-1) break;
     }
   }
   else {
-    lock_acquire (&filesys_lock);
-    struct file *file = cur->fd[fd];
+    struct file *file = fd_pin (fd);
     if (file != NULL) {
-      if (file_get_inode (file) == file_get_inode(cur->md->exec_file))
+      if (file_get_inode (file)
+          == file_get_inode (cur->process->md->exec_file))
         file_deny_write (file);
-      retval = file_read (file, buffer, size);
-      cur->fd[fd] = file;
+      retval = read_to_user (file, buffer, size, true);
+      fd_unpin (fd, file);
     }
     else retval = -1;
-    if (lock_held_by_current_thread (&filesys_lock))
-      lock_release (&filesys_lock);
   }
   return retval;
 }
@@ -233,70 +715,283 @@ int
 write (int file_desc, const void *_buffer, unsigned size)
 {
   char *buffer = (char *)_buffer;
-  struct thread *cur = thread_current ();
   struct file *file_to_write;
 
-  if (buffer == NULL)
-    exit (-1);
   int retval;
-  if (file_desc < 1 || file_desc > MAX_FD)
+  if (file_desc == 0)
     return -1;
-  if (file_desc == 1) {
-    putbuf (buffer, size);
-    retval = size;
-  }
+  if (file_desc == 1)
+    retval = write_from_user (NULL, buffer, size, true);
   else
   {
-    lock_acquire (&filesys_lock);
-    file_to_write = cur->fd[file_desc];
+    file_to_write = fd_pin (file_desc);
     if (file_to_write != NULL) {
-    	retval = file_write (file_to_write, buffer, size);
-    	cur->fd[file_desc] = file_to_write;
+    	retval = write_from_user (file_to_write, buffer, size, true);
         file_allow_write (file_to_write);
+        fd_unpin (file_desc, file_to_write);
     }
     else retval = -1;
-    if (lock_held_by_current_thread (&filesys_lock))
-      lock_release (&filesys_lock);
   }
   return retval;
 }
 
+/* Copies the IOVCNT buffer descriptors at user address UIOV into
+   IOV, which has room for IOV_MAX.  Returns the total length of
+   the buffers, or -1 if IOVCNT is out of range or the total
+   exceeds INT_MAX.  Kills the process if UIOV is not readable
+   user memory. */
+static int
+copy_iovec (struct iovec *iov, const struct iovec *uiov, int iovcnt)
+{
+  size_t total = 0;
+  int i;
+
+  if (iovcnt < 0 || iovcnt > IOV_MAX)
+    return -1;
+  if (!copy_from_user (iov, uiov, iovcnt * sizeof *iov))
+    exit (-1);
+  for (i = 0; i < iovcnt; i++)
+    {
+      if (iov[i].iov_len > INT_MAX - total)
+        return -1;
+      total += iov[i].iov_len;
+    }
+  return total;
+}
+
+/* Reads from file FD into the IOVCNT buffers described at UIOV,
+   filling each in turn, as one read of their total length.
+   Returns the number of bytes read, or -1 if FD is not open or
+   is the keyboard, or the buffers are invalid.  The file layer is
+   called once per page of data rather than once per buffer. */
+int
+readv (int fd, const struct iovec *uiov, int iovcnt)
+{
+  struct iovec iov[IOV_MAX];
+  struct bounce b;
+  struct file *file;
+  int total, done = 0;
+  int seg = 0;
+  size_t seg_ofs = 0;
+
+  if (fd == 1)
+    exit (-1);
+  if (fd == 0)
+    return -1;
+  total = copy_iovec (iov, uiov, iovcnt);
+  if (total < 0)
+    return -1;
+  file = fd_pin (fd);
+  if (file == NULL)
+    return -1;
+  if (!bounce_init (&b, total))
+    {
+      fd_unpin (fd, file);
+      return -1;
+    }
+
+  while (done < total)
+    {
+      int chunk = total - done < (int) b.size ? total - done : (int) b.size;
+      int n = file_read (file, b.buf, chunk);
+      int pos = 0;
+
+      /* Scatter the data over the buffers. */
+      while (pos < n)
+        {
+          size_t cnt = iov[seg].iov_len - seg_ofs;
+
+          if (cnt == 0)
+            {
+              seg++;
+              seg_ofs = 0;
+              continue;
+            }
+          if (cnt > (size_t) (n - pos))
+            cnt = n - pos;
+          if (!copy_to_user ((uint8_t *) iov[seg].iov_base + seg_ofs,
+                             b.buf + pos, cnt))
+            {
+              bounce_free (&b);
+              exit (-1);
+            }
+          pos += cnt;
+          seg_ofs += cnt;
+          if (seg_ofs == iov[seg].iov_len)
+            {
+              seg++;
+              seg_ofs = 0;
+            }
+        }
+      done += n;
+      if (n < chunk)
+        break;
+    }
+  bounce_free (&b);
+  fd_unpin (fd, file);
+  return done;
+}
+
+/* Writes the IOVCNT buffers described at UIOV to file FD, in
+   order, as one write of their total length.  Returns the number
+   of bytes written, or -1 if FD is not open or is the keyboard,
+   or the buffers are invalid.  The buffers are gathered into a
+   page-sized bounce buffer, so that the file layer is called, or
+   for the console putbuf() emits the output under the console
+   lock, once per page of data rather than once per buffer. */
+int
+writev (int fd, const struct iovec *uiov, int iovcnt)
+{
+  struct iovec iov[IOV_MAX];
+  struct bounce b;
+  struct file *file = NULL;
+  int total, done = 0;
+  unsigned filled = 0;
+  int i;
+
+  if (fd == 0)
+    return -1;
+  total = copy_iovec (iov, uiov, iovcnt);
+  if (total < 0)
+    return -1;
+  if (fd != 1)
+    {
+      file = fd_pin (fd);
+      if (file == NULL)
+        return -1;
+    }
+  if (!bounce_init (&b, total))
+    {
+      if (file != NULL)
+        fd_unpin (fd, file);
+      return -1;
+    }
+
+  for (i = 0; i < iovcnt; i++)
+    {
+      const uint8_t *base = iov[i].iov_base;
+      size_t left = iov[i].iov_len;
+
+      while (left > 0)
+        {
+          size_t cnt = b.size - filled < left ? b.size - filled : left;
+
+          if (!copy_from_user (b.buf + filled, base, cnt))
+            {
+              bounce_free (&b);
+              exit (-1);
+            }
+          filled += cnt;
+          base += cnt;
+          left -= cnt;
+          if (filled == b.size)
+            {
+              int n = bounce_flush (file, b.buf, filled);
+
+              done += n;
+              if ((unsigned) n < filled)
+                goto out;
+              filled = 0;
+            }
+        }
+    }
+  if (filled > 0)
+    done += bounce_flush (file, b.buf, filled);
+
+ out:
+  bounce_free (&b);
+  if (file != NULL)
+    fd_unpin (fd, file);
+  return done;
+}
+
+/* Returns the file open as FD in the current process, or a null
+   pointer if FD is not open.  The file is pinned: the file table
+   is shared with our other threads, and if one of them closes FD
+   meanwhile, the file is only closed once fd_unpin() releases the
+   last pin. */
+static struct file *
+fd_pin (int fd)
+{
+  struct process *p = thread_current ()->process;
+  struct file *file;
+
+  lock_acquire (&p->lock);
+  file = p->fd[fd];
+  if (file != NULL)
+    p->fd_pins[fd]++;
+  lock_release (&p->lock);
+  return file;
+}
+
+/* Releases the pin that fd_pin() took on FILE, open as FD, and
+   closes FILE if FD was closed in the meantime and no other pin
+   remains. */
+static void
+fd_unpin (int fd, struct file *file)
+{
+  struct process *p = thread_current ()->process;
+  bool last;
+
+  lock_acquire (&p->lock);
+  last = --p->fd_pins[fd] == 0 && p->fd_closing[fd];
+  if (last)
+    p->fd_closing[fd] = false;
+  lock_release (&p->lock);
+  if (last)
+    file_close (file);
+}
+
 void
 close (int fd)
 {
-  struct thread *cur = thread_current ();
-  lock_acquire (&filesys_lock);
-  file_close (cur->fd[fd]);
-  cur->fd[fd] = NULL;
-  if (lock_held_by_current_thread (&filesys_lock))
-    lock_release (&filesys_lock);
+  struct process *p = thread_current ()->process;
+  struct file *file;
+  bool pinned;
+
+  lock_acquire (&p->lock);
+  file = p->fd[fd];
+  p->fd[fd] = NULL;
+  pinned = file != NULL && p->fd_pins[fd] > 0;
+  if (pinned)
+    p->fd_closing[fd] = true;
+  lock_release (&p->lock);
+  if (!pinned)
+    file_close (file);
 }
 
 int
 filesize (int fd)
 {
-  struct file *file = thread_current ()->fd[fd];
+  struct file *file = fd_pin (fd);
+  int length;
   if (file == NULL)
    exit (-1);
-  return file_length (file);
+  length = file_length (file);
+  fd_unpin (fd, file);
+  return length;
 }
 
 unsigned
 tell (int fd)
 {
-  struct file *file = thread_current ()->fd[fd];
+  struct file *file = fd_pin (fd);
+  unsigned position;
   if (file == NULL)
    exit (-1);
-  return file_tell (file);
+  position = file_tell (file);
+  fd_unpin (fd, file);
+  return position;
 } 
 
 void
 seek (int fd, unsigned position)
 {
-  struct file *file = thread_current ()->fd[fd];
+  struct file *file = fd_pin (fd);
   if (file == NULL)
    exit (-1);
   file_seek (file, position);
+  fd_unpin (fd, file);
 }
 
 pid_t
@@ -313,14 +1008,451 @@ wait (pid_t pid)
 {
   return process_wait((tid_t)pid);
 }
-/*the above commentThis code defines various file system functions for a Unix-style operating system in C language.
- The functions include creating a file (create()), 
- opening a file (open()), reading from a file (read()), 
- writing to a file (write()), closing a file (close()),
-  getting the size of a file (filesize()), 
-  getting the current position of a file (tell()), 
-  and setting the position of a file (seek()). 
-  These functions use a lock (filesys_lock) to ensure mutual exclusion when accessing the file system, 
-and some functions have error checks for invalid input parameters.*/
 
+/* Adds INCREMENT to the nice value of the current process and
+   returns the resulting nice value, which is clamped to
+   NICE_MIN...NICE_MAX.  Only affects scheduling under -mlfqs. */
+int
+nice (int increment)
+{
+  if (increment > NICE_MAX - NICE_MIN)
+    increment = NICE_MAX - NICE_MIN;
+  else if (increment < NICE_MIN - NICE_MAX)
+    increment = NICE_MIN - NICE_MAX;
+  thread_set_nice (thread_get_nice () + increment);
+  return thread_get_nice ();
+}
+
+/* Returns the current priority of the current process. */
+int
+getpriority (void)
+{
+  return thread_get_priority ();
+}
+
+/* Blocks the current process for at least MS milliseconds,
+   rounded up to whole timer ticks. */
+void
+sleep_ms (unsigned ms)
+{
+  timer_sleep (DIV_ROUND_UP ((int64_t) ms * TIMER_FREQ, 1000));
+}
+
+/* Converts MS milliseconds to timer ticks, rounding up. */
+static int64_t
+ms_to_ticks (unsigned ms)
+{
+  return DIV_ROUND_UP ((int64_t) ms * TIMER_FREQ, 1000);
+}
+
+/* Moves the current process into the earliest-deadline-first
+   class, with a job of up to RUNTIME_MS released every
+   PERIOD_MS, each due DEADLINE_MS after its release.  A
+   PERIOD_MS of 0 leaves the class.  Returns 0 if successful, -1
+   if the parameters are invalid or would overcommit the CPU. */
+int
+sched_deadline (unsigned period_ms, unsigned runtime_ms,
+                unsigned deadline_ms)
+{
+  return thread_set_deadline (ms_to_ticks (period_ms),
+                              ms_to_ticks (runtime_ms),
+                              ms_to_ticks (deadline_ms)) ? 0 : -1;
+}
+
+/* Tells the scheduler that the current EDF job is complete. */
+void
+sched_yield (void)
+{
+  thread_yield_job ();
+}
+
+/* If NEW_TICKETS is positive, sets the current process's stride
+   scheduler tickets to it, clamped to TICKETS_MAX.  Returns the
+   process's tickets. */
+int
+tickets (int new_tickets)
+{
+  if (new_tickets > TICKETS_MAX)
+    new_tickets = TICKETS_MAX;
+  if (new_tickets > 0)
+    thread_set_tickets (new_tickets);
+  return thread_get_tickets ();
+}
+
+/* Moves the current process to process group GROUP, which the
+   processes it executes from now on inherit.  Returns 0 if
+   successful, -1 if GROUP is out of range. */
+int
+setgroup (int group)
+{
+  return thread_set_group (group) ? 0 : -1;
+}
+
+/* Limits process group GROUP to QUOTA_MS of CPU time in every
+   PERIOD_MS, or lifts the limit if QUOTA_MS is 0.  Returns 0 if
+   successful, -1 if the arguments are invalid. */
+int
+group_quota (int group, unsigned quota_ms, unsigned period_ms)
+{
+  return thread_set_group_quota (group, ms_to_ticks (quota_ms),
+                                 ms_to_ticks (period_ms)) ? 0 : -1;
+}
+/* Starts a new thread in the current process, running START as
+   if called as START (FUNC, AUX).  START, normally a wrapper in
+   the user library, must not return; it should end the thread
+   with uthread_exit().  Returns the new thread's tid, or -1 if
+   the thread cannot be created. */
+tid_t
+uthread_create (void (*start) (void), void *func, void *aux)
+{
+  if (!is_user_vaddr (start))
+    exit (-1);
+  return process_thread_create (start, func, aux);
+}
+
+/* Waits for thread TID, created by the calling thread, to exit.
+   Returns 0 if successful, -1 if TID is not such a thread or has
+   already been joined. */
+int
+uthread_join (tid_t tid)
+{
+  return process_thread_join (tid);
+}
+
+/* Ends the calling thread.  The process ends when its last
+   thread does, as if by exit (0). */
+void
+uthread_exit (void)
+{
+  if (process_thread_cnt () == 1)
+    exit (0);
+  thread_exit ();
+}
+
+/* Returns the kernel address of the user word at ADDR, killing
+   the process if ADDR is unmapped or not word-aligned, so that
+   the word cannot straddle a page boundary. */
+static int *
+futex_word (int *addr)
+{
+  int *word;
+
+  if (!is_user_vaddr (addr) || (uintptr_t) addr % sizeof *addr != 0)
+    exit (-1);
+  word = pagedir_get_page (thread_current ()->pagedir, addr);
+  if (word == NULL)
+    exit (-1);
+  return word;
+}
 
+/* If the word at ADDR holds EXPECTED, blocks until another
+   thread calls futex_wake() on the same word or TIMEOUT_MS
+   milliseconds pass.  A negative TIMEOUT_MS waits indefinitely.
+   Returns 0 if woken, 1 if the word did not hold EXPECTED, -1
+   on timeout. */
+int
+futex_wait (int *addr, int expected, int timeout_ms)
+{
+  int *word = futex_word (addr);
+
+  return futex_sleep (word, expected,
+                      timeout_ms < 0 ? -1 : ms_to_ticks (timeout_ms));
+}
+
+/* Wakes up to N threads blocked in futex_wait() on the word at
+   ADDR.  Returns the number of threads woken. */
+int
+futex_wake (int *addr, int n)
+{
+  int *word = futex_word (addr);
+
+  return n > 0 ? futex_wakeup (word, n) : 0;
+}
+
+/* Copies system call statistics into BUFFER, which is SIZE bytes
+   long, as an array of struct syscall_stats indexed by system
+   call number.  SCOPE is SYSSTATS_SYSTEM for the statistics of
+   all processes since boot or SYSSTATS_PROCESS for those of the
+   calling process.  Returns the number of system call numbers,
+   which may be more than fit in BUFFER, or -1 if SCOPE is
+   invalid. */
+int
+sysstats (int scope, void *buffer, unsigned size)
+{
+  struct syscall_stats *dst = buffer;
+  const struct syscall_stats *src;
+  int cnt = size / sizeof *dst;
+  int i;
+
+  if (scope == SYSSTATS_SYSTEM)
+    src = syscall_stats;
+  else if (scope == SYSSTATS_PROCESS)
+    src = thread_current ()->process->syscall_stats;
+  else
+    return -1;
+
+  if (cnt > SYSCALL_CNT)
+    cnt = SYSCALL_CNT;
+  for (i = 0; i < cnt; i++)
+    {
+      struct syscall_stats s;
+      enum intr_level old_level;
+
+      if (src != NULL)
+        {
+          old_level = intr_disable ();
+          s = src[i];
+          intr_set_level (old_level);
+        }
+      else
+        memset (&s, 0, sizeof s);
+      s.us = timer_cycles_to_us (s.cycles);
+      if (!copy_to_user (&dst[i], &s, sizeof s))
+        exit (-1);
+    }
+  return SYSCALL_CNT;
+}
+
+/* Registers the rings described by the struct uring at user
+   address URING for the current process, replacing any rings
+   registered before, and resets their indexes to 0.  Returns 0
+   if successful, -1 if the number of entries is not a power of
+   2 between 1 and URING_ENTRIES_MAX. */
+int
+uring_setup (struct uring *uring)
+{
+  struct process *p = thread_current ()->process;
+  struct uring r;
+
+  if (!copy_from_user (&r, uring, sizeof r))
+    exit (-1);
+  if (r.entries == 0 || r.entries > URING_ENTRIES_MAX
+      || (r.entries & (r.entries - 1)) != 0)
+    return -1;
+
+  r.sq_head = r.sq_tail = r.cq_head = r.cq_tail = 0;
+  lock_acquire (&p->uring_lock);
+  if (!copy_to_user (uring, &r, sizeof r))
+    {
+      lock_release (&p->uring_lock);
+      exit (-1);
+    }
+  p->uring = uring;
+  p->uring_entries = r.entries;
+  p->uring_sqes = r.sqes;
+  p->uring_cqes = r.cqes;
+  lock_release (&p->uring_lock);
+  return 0;
+}
+
+/* The ring operations below behave like the system calls of the
+   same names, except that where those kill the process for a
+   bad file descriptor, buffer or file name, these return -1.  A
+   ring entry cannot read from the keyboard. */
+
+/* Returns the file open as FD, pinned with fd_pin(), or a null
+   pointer if FD is out of range or not open. */
+static struct file *
+uring_file (int fd)
+{
+  return fd >= 2 && fd < MAX_FD ? fd_pin (fd) : NULL;
+}
+
+static int
+uring_read (int fd, void *ubuf, unsigned size)
+{
+  struct file *file = uring_file (fd);
+  int n;
+
+  if (file == NULL)
+    return -1;
+  n = read_to_user (file, ubuf, size, false);
+  fd_unpin (fd, file);
+  return n;
+}
+
+static int
+uring_write (int fd, const void *ubuf, unsigned size)
+{
+  struct file *file;
+  int n;
+
+  if (fd == 1)
+    return write_from_user (NULL, ubuf, size, false);
+  file = uring_file (fd);
+  if (file == NULL)
+    return -1;
+  n = write_from_user (file, ubuf, size, false);
+  fd_unpin (fd, file);
+  return n;
+}
+
+static int
+uring_seek (int fd, unsigned position)
+{
+  struct file *file = uring_file (fd);
+
+  if (file == NULL)
+    return -1;
+  file_seek (file, position);
+  fd_unpin (fd, file);
+  return 0;
+}
+
+static int
+uring_open (const char *ufile)
+{
+  char *kfile = palloc_get_page (0);
+  int len, fd = -1;
+
+  if (kfile == NULL)
+    return -1;
+  len = strncpy_from_user (kfile, ufile, PGSIZE);
+  if (len >= 0 && len < PGSIZE)
+    fd = open (kfile);
+  palloc_free_page (kfile);
+  return fd;
+}
+
+static int
+uring_close (int fd)
+{
+  if (fd < 2 || fd >= MAX_FD)
+    return -1;
+  close (fd);
+  return 0;
+}
+
+/* Runs the operation in SQE and returns its result. */
+static int
+uring_run (const struct uring_sqe *sqe)
+{
+  switch (sqe->opcode)
+    {
+    case URING_NOP:
+      return 0;
+    case URING_READ:
+      return uring_read (sqe->fd, sqe->addr, sqe->len);
+    case URING_WRITE:
+      return uring_write (sqe->fd, sqe->addr, sqe->len);
+    case URING_SEEK:
+      return uring_seek (sqe->fd, sqe->len);
+    case URING_OPEN:
+      return uring_open (sqe->addr);
+    case URING_CLOSE:
+      return uring_close (sqe->fd);
+    default:
+      return -1;
+    }
+}
+
+/* Runs up to TO_SUBMIT operations from the current process's
+   submission ring, in order, and posts their completions.  Stops
+   early if the submission ring empties or the completion ring
+   fills up.  Returns the number of operations run, or -1 if the
+   process has not registered rings.
+
+   All operations run in one trap, so a batch of small reads or
+   writes pays for the system call entry and exit only once.
+   Threads of a process enter one at a time, so that no entry
+   runs twice. */
+int
+uring_enter (unsigned to_submit)
+{
+  struct process *p = thread_current ()->process;
+  unsigned mask;
+  struct uring r;
+  unsigned done;
+
+  lock_acquire (&p->uring_lock);
+  if (p->uring == NULL)
+    {
+      lock_release (&p->uring_lock);
+      return -1;
+    }
+  mask = p->uring_entries - 1;
+  if (!copy_from_user (&r, p->uring, sizeof r))
+    goto fault;
+
+  for (done = 0; done < to_submit && r.sq_head != r.sq_tail; done++)
+    {
+      struct uring_sqe sqe;
+      struct uring_cqe cqe;
+
+      /* The process may have consumed completions meanwhile. */
+      if (r.cq_tail - r.cq_head >= p->uring_entries
+          && (!copy_from_user (&r.cq_head, &p->uring->cq_head,
+                               sizeof r.cq_head)
+              || r.cq_tail - r.cq_head >= p->uring_entries))
+        break;
+
+      if (!copy_from_user (&sqe, &p->uring_sqes[r.sq_head & mask],
+                           sizeof sqe))
+        goto fault;
+      r.sq_head++;
+
+      cqe.user_data = sqe.user_data;
+      cqe.res = uring_run (&sqe);
+      if (!copy_to_user (&p->uring_cqes[r.cq_tail & mask], &cqe,
+                         sizeof cqe))
+        goto fault;
+      r.cq_tail++;
+    }
+
+  if (!copy_to_user (&p->uring->sq_head, &r.sq_head, sizeof r.sq_head)
+      || !copy_to_user (&p->uring->cq_tail, &r.cq_tail, sizeof r.cq_tail))
+    goto fault;
+  lock_release (&p->uring_lock);
+  return done;
+
+ fault:
+  /* The rings themselves are bad. */
+  lock_release (&p->uring_lock);
+  exit (-1);
+}
+
+/* Returns the time in microseconds within which PERCENT percent
+   of the calls counted in S completed, rounded up to a histogram
+   bucket boundary. */
+static uint64_t
+percentile_us (const struct syscall_stats *s, int percent)
+{
+  long long want = (s->calls * percent + 99) / 100;
+  long long seen = 0;
+  int i;
+
+  for (i = 0; i < SYSCALL_HIST_CNT - 1; i++)
+    {
+      seen += s->hist[i];
+      if (seen >= want)
+        break;
+    }
+  return timer_cycles_to_us (1ULL << (SYSCALL_HIST_SHIFT + i + 1));
+}
+
+/* Prints the number of calls of each system call since boot and
+   how long they took. */
+void
+syscall_print_stats (void)
+{
+  int nr;
+
+  printf ("%-16s %10s %12s %10s %10s %10s\n", "syscall", "calls",
+          "total(us)", "avg(us)", "p50(us)", "p99(us)");
+  for (nr = 0; nr < SYSCALL_CNT; nr++)
+    {
+      struct syscall_stats s;
+      enum intr_level old_level;
+
+      old_level = intr_disable ();
+      s = syscall_stats[nr];
+      intr_set_level (old_level);
+
+      if (s.calls != 0)
+        printf ("%-16s %10lld %12llu %10llu %10llu %10llu\n",
+                syscall_table[nr].name, s.calls,
+                timer_cycles_to_us (s.cycles),
+                timer_cycles_to_us (s.cycles / s.calls),
+                percentile_us (&s, 50), percentile_us (&s, 99));
+    }
+}
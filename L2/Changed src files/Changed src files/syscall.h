@@ -0,0 +1,7 @@
+#ifndef USERPROG_SYSCALL_H
+#define USERPROG_SYSCALL_H
+
+void syscall_init (void);
+void syscall_print_stats (void);
+
+#endif /* userprog/syscall.h */
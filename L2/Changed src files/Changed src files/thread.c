@@ -1,5 +1,6 @@
 #include "threads/thread.h"
 #include <debug.h>
+#include <limits.h>
 #include <stddef.h>
 #include <random.h>
 #include <stdio.h>
@@ -7,11 +8,19 @@
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
+#include "threads/irqtrace.h"
+#include "threads/init.h"
 #include "threads/palloc.h"
+#include "threads/pte.h"
+#include "threads/spinlock.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
+#include "threads/trace.h"
+#include "threads/tsc.h"
 #include "threads/vaddr.h"
 #include "threads/malloc.h"
+#include "threads/workqueue.h"
+#include "devices/timer.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #endif
@@ -21,22 +30,142 @@
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/* Number of distinct thread priorities. */
+#define PRI_CNT (PRI_MAX - PRI_MIN + 1)
+
+/* Maximum number of ready threads under the stride policy.  thread_create() refuses to create more threads than
+   that, so the heap cannot overflow. */
+#define STRIDE_HEAP_MAX 1024
+
+/* Run queue of processes in THREAD_READY state, that is,
+   processes that are ready to run but not actually running,
+   protected by its spinlock.
+
+   The priority policy keeps one FIFO list per priority.  Bit P
+   of BITMAP is set if and only if QUEUES[P] is non-empty, so the
+   highest-priority ready thread is found with a bit scan instead
+   of a walk over every ready thread.  The stride policy keeps a
+   heap instead, and EDF threads are kept apart from both. */
+struct runqueue
+  {
+    struct spinlock lock;       /* Protects the members below. */
+    int cnt;                    /* # of threads in the run queue. */
+    struct list queues[PRI_CNT]; /* Priority policy: one per priority. */
+    uint64_t bitmap;            /* Priority policy: non-empty queues. */
+    struct list edf;            /* EDF threads, by deadline. */
+    struct thread *stride_heap[STRIDE_HEAP_MAX]; /* Min-heap on pass. */
+    size_t stride_cnt;          /* # of threads in stride_heap. */
+    int64_t stride_vtime;       /* Pass of most recently picked thread. */
+  };
+
+static struct runqueue ready_rq;
+
+/* Running thread, recorded by schedule(). */
+static struct thread *current_thread;
+
+/* Idle thread.  Runs when the run queue is empty. */
+static struct thread *idle_thread;
+
+/* A policy for scheduling the threads outside the EDF class.
+   The run queue functions below hand those threads to it.  All
+   of its functions except TICK are called with the run queue's
+   lock held. */
+struct sched_policy
+  {
+    const char *name;
+    void (*push) (struct runqueue *, struct thread *); /* Adds a thread. */
+    void (*remove) (struct runqueue *, struct thread *); /* Removes one. */
+    struct thread *(*pop) (struct runqueue *); /* Removes the next one. */
+    bool (*preempts) (struct runqueue *, const struct thread *cur);
+                                        /* Should CUR yield? */
+    void (*tick) (struct thread *);     /* Charges a tick, if non-null. */
+  };
+
+static void prio_push (struct runqueue *, struct thread *);
+static void prio_remove (struct runqueue *, struct thread *);
+static struct thread *prio_pop (struct runqueue *);
+static bool prio_preempts (struct runqueue *, const struct thread *);
+static void stride_push (struct runqueue *, struct thread *);
+static void stride_remove (struct runqueue *, struct thread *);
+static struct thread *stride_pop (struct runqueue *);
+static bool stride_preempts (struct runqueue *, const struct thread *);
+static void stride_tick (struct thread *);
+
+static const struct sched_policy priority_policy =
+  {"priority", prio_push, prio_remove, prio_pop, prio_preempts, NULL};
+static const struct sched_policy stride_policy =
+  {"stride", stride_push, stride_remove, stride_pop, stride_preempts,
+   stride_tick};
+
+/* Current scheduling policy.  Controlled by kernel command-line
+   option "-sched". */
+static const struct sched_policy *sched_policy = &priority_policy;
+
+/* Pass advance per tick at 1 ticket, for the stride policy. */
+#define STRIDE1 (1 << 20)
+
+/* Earliest-deadline-first class.  Ready EDF threads are kept
+   apart from the other threads in each run queue, in order of
+   increasing absolute deadline, and always run ahead of them.
+   Each EDF thread is a series of jobs released once per period,
+   each of which gets a fixed budget of ticks; a thread that uses
+   up its budget is throttled until its next release.  Admission
+   control keeps the total utilization, the sum of each thread's
+   runtime / period, at or below 100%, expressed here in parts
+   per EDF_UTIL_SCALE. */
+#define EDF_UTIL_SCALE 1000000
+static int64_t edf_util;
+
+/* Process groups, for CPU bandwidth control.  Every thread
+   belongs to a group, inherited from its creator; group 0, the
+   one the initial thread starts in, is never limited.  A group
+   with a quota may run for at most QUOTA ticks in each PERIOD.
+   Once it has used them up, its threads are parked on the
+   group's PARKED list, off the run queue, until a timer event
+   refills the quota at the start of the next period.  EDF
+   threads are not subject to group quotas. */
+struct thread_group
+  {
+    int id;                     /* Index in groups[]. */
+    int64_t quota;              /* Ticks allowed per period, or 0. */
+    int64_t period;             /* Length of period, in ticks. */
+    int64_t used;               /* Ticks used in this period. */
+    int64_t last_used;          /* Ticks used in the last period. */
+    int64_t total;              /* Ticks used ever. */
+    unsigned throttles;         /* # of periods that hit the quota. */
+    int members;                /* # of threads in the group. */
+    bool throttled;             /* Out of quota for this period? */
+    struct list parked;         /* Threads waiting for a refill. */
+    struct timer_event refill;  /* Fires at the start of each period. */
+  };
+static struct thread_group groups[GROUP_CNT];
 
 /* List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
 static struct list all_list;
-
-/* Idle thread. */
-static struct thread *idle_thread;
+static struct spinlock all_lock;        /* Protects all_list. */
+static int thread_cnt;          /* Live threads; also under all_lock. */
 
 /* Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
 
-/* Lock used by allocate_tid(). */
-static struct lock tid_lock;
+/* Frees the pages of threads that have exited, off the context
+   switch path.  Until it is running, thread_schedule_tail() frees
+   them itself. */
+static struct workqueue reaper_wq;
+static bool reaper_running;
+
+/* Held by the reaper while it frees a thread, and by
+   thread_print_stats() while it scans the kernel stacks of other
+   threads, so that no stack is freed under the scan. */
+static struct lock reap_lock;
+
+/* Table of process metadata, hashed by tid.  Readers and
+   writers alike hold tid_table_lock only for the length of one
+   bucket walk. */
+#define TID_BUCKETS 256
+static struct child_metadata *tid_table[TID_BUCKETS];
+static struct spinlock tid_table_lock;
 
 /* Stack frame for kernel_thread(). */
 struct kernel_thread_frame 
@@ -46,20 +175,69 @@ struct kernel_thread_frame
     void *aux;                  /* Auxiliary data for function. */
   };
 
+/* Maximum length of a chain of nested priority donations. */
+#define DONATION_DEPTH 8
+
 /* Statistics. */
 static long long idle_ticks;    /* # of timer ticks spent idle. */
 static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
 static long long user_ticks;    /* # of timer ticks in user programs. */
 
+/* Scheduler statistics. */
+static long long switch_cnt;    /* # of context switches. */
+static long long wakeup_cnt;    /* # of woken threads that got to run. */
+static uint64_t wakeup_cycles;  /* Total time from wakeup to running. */
+static uint64_t wakeup_max;     /* Longest time from wakeup to running. */
+
 /* Scheduling. */
-#define TIME_SLICE 4            /* # of timer ticks to give each thread. */
 static unsigned thread_ticks;   /* # of timer ticks since last yield. */
 
+/* Range of time slices, in timer ticks.  A thread at PRI_MIN
+   gets the longest slice and one at PRI_MAX the shortest, so
+   that low-priority batch work switches less often.  Controlled
+   by kernel command-line options "-tslice-min" and
+   "-tslice-max". */
+unsigned thread_slice_min = 2;
+unsigned thread_slice_max = 6;
+
+/* Number of priority levels a thread gains when it wakes up,
+   kept until it uses up a time slice or blocks again.  Helps
+   interactive threads that sleep on I/O get in ahead of busy
+   ones at the same priority.  Controlled by kernel command-line
+   option "-wakeboost". */
+int thread_wake_boost;
+
+/* Size of each kernel stack, in pages, not counting its guard
+   page.  Controlled by kernel command-line option "-kstack". */
+unsigned thread_kstack_pages = KSTACK_PAGES_DEFAULT;
+
+/* Deepest use of any kernel stack by a thread that has exited. */
+static size_t kstack_peak;
+static char kstack_peak_name[16];
+
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/* Multi-level feedback queue scheduler.
+
+   Every thread's recent_cpu decays once per second, but a thread
+   that is blocked cannot gain recent_cpu and has no use for a
+   fresh priority until it is unblocked.  So instead of walking
+   every thread once per second, we only bring the running and
+   ready threads up to date then, and record the decay
+   coefficient of each second in decay_history[].  A blocked
+   thread remembers in its cpu_epoch how many decay steps it has
+   seen and replays the ones it missed when it is unblocked.
+   Only the last DECAY_HISTORY coefficients are kept; steps older
+   than that are replayed with the oldest recorded coefficient,
+   by repeated squaring so that a long sleep costs O(log n). */
+#define DECAY_HISTORY 64        /* Seconds of decay history kept. */
+static fixed_t load_avg;        /* System load average. */
+static fixed_t decay_history[DECAY_HISTORY]; /* Coefficient per second. */
+static int64_t decay_epoch;     /* # of decay steps so far. */
+
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
@@ -68,9 +246,42 @@ static struct thread *next_thread_to_run (void);
 static void init_thread (struct thread *, const char *name, int priority);
 static bool is_thread (struct thread *) UNUSED;
 static void *alloc_frame (struct thread *, size_t size);
+static uint8_t *kstack_alloc (void);
+static void kstack_free (struct thread *);
+static bool thread_cnt_reserve (void);
+static void thread_cnt_release (void);
+static size_t kstack_usage (const struct thread *);
 static void schedule (void);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
+static void release_children (struct thread *);
+static bool is_idle (const struct thread *);
+static void ready_queue_push (struct thread *);
+static void rq_push (struct runqueue *, struct thread *);
+static void rq_remove (struct runqueue *, struct thread *);
+static void set_effective_priority (struct thread *, int priority);
+static void mlfqs_catch_up (struct thread *);
+static void mlfqs_decay_steps (struct thread *, fixed_t coef, int64_t);
+static int mlfqs_priority (const struct thread *);
+static void mlfqs_update_priority (struct thread *);
+static void mlfqs_second (void);
+static unsigned time_slice (const struct thread *);
+static void set_boost (struct thread *, int boost);
+static work_func reap_thread;
+static work_func reap_work;
+static bool edf_earlier (const struct list_elem *, const struct list_elem *,
+                         void *aux);
+static void edf_leave (struct thread *);
+static bool group_throttled (const struct thread *);
+static void group_park (struct thread *);
+static void switch_bench_measure (int ready);
+static thread_func switch_bench_pinger;
+static thread_func switch_bench_filler;
+static void edf_bench_run (bool loaded);
+static thread_func edf_bench_task;
+static thread_func edf_bench_load;
+static void stride_bench_snapshot (uint64_t cycles[]);
+static thread_func stride_bench_spinner;
 struct child_metadata *init_child_metadata (tid_t child_tid);
 
 /* Initializes the threading system by transforming the code
@@ -78,7 +289,8 @@ struct child_metadata *init_child_metadata (tid_t child_tid);
    general and it is possible in this case only because loader.S
    was careful to put the bottom of the stack at a page boundary.
 
-   Also initializes the run queue and the tid lock.
+   Also initializes the run queues and the locks on shared
+   scheduler data.
 
    After calling this function, be sure to initialize the page
    allocator before trying to create any threads with
@@ -89,17 +301,35 @@ struct child_metadata *init_child_metadata (tid_t child_tid);
 void
 thread_init (void) 
 {
+  uint32_t *esp;
+  int i;
+
   ASSERT (intr_get_level () == INTR_OFF);
 
-  lock_init (&tid_lock);
-  list_init (&ready_list);
+  spinlock_init (&ready_rq.lock, "runqueue");
+  for (i = 0; i < PRI_CNT; i++)
+    list_init (&ready_rq.queues[i]);
+  list_init (&ready_rq.edf);
+  for (i = 0; i < GROUP_CNT; i++)
+    {
+      groups[i].id = i;
+      list_init (&groups[i].parked);
+    }
   list_init (&all_list);
+  spinlock_init (&all_lock, "all_list");
+  spinlock_init (&tid_table_lock, "tid_table");
+  lock_init (&reap_lock);
 
-  /* Set up a thread structure for the running thread. */
-  initial_thread = running_thread ();
+  /* Set up a thread structure for the running thread.  loader.S
+     put the bottom of its stack at a page boundary, so the
+     thread structure goes at the start of the stack's page. */
+  asm ("mov %%esp, %0" : "=g" (esp));
+  initial_thread = pg_round_down (esp);
+  current_thread = initial_thread;
   init_thread (initial_thread, "main", PRI_DEFAULT);
   initial_thread->status = THREAD_RUNNING;
   initial_thread->tid = allocate_tid ();
+  thread_cnt = 1;
 }
 
 /* Starts preemptive thread scheduling by enabling interrupts.
@@ -117,6 +347,11 @@ thread_start (void)
 
   /* Wait for the idle thread to initialize idle_thread. */
   sema_down (&idle_started);
+
+  /* Start the reaper. */
+  if (!workqueue_create (&reaper_wq, "reaper", PRI_DEFAULT))
+    PANIC ("cannot create reaper thread");
+  reaper_running = true;
 }
 
 /* Called by the timer interrupt handler at each timer tick.
@@ -125,9 +360,10 @@ void
 thread_tick (void) 
 {
   struct thread *t = thread_current ();
+  struct thread_group *g = t->group;
 
   /* Update statistics. */
-  if (t == idle_thread)
+  if (is_idle (t))
     idle_ticks++;
 #ifdef USERPROG
   else if (t->pagedir != NULL)
@@ -136,17 +372,645 @@ thread_tick (void)
   else
     kernel_ticks++;
 
-  /* Enforce preemption. */
-  if (++thread_ticks >= TIME_SLICE)
-    intr_yield_on_return ();
+  if (thread_mlfqs)
+    {
+      if (!is_idle (t))
+        t->recent_cpu = fp_add_int (t->recent_cpu, 1);
+      if (timer_ticks () % TIMER_FREQ == 0)
+        mlfqs_second ();
+      if (timer_ticks () % 4 == 0 && !is_idle (t))
+        {
+          mlfqs_update_priority (t);
+          thread_preempt ();
+        }
+    }
+
+  if (is_idle (t))
+    return;
+
+  if (sched_policy->tick != NULL && !t->edf)
+    sched_policy->tick (t);
+
+  /* Charge the group, and stop running once it is out of quota.
+     EDF threads sit above the groups: their time is limited by
+     their own budget and does not use up their group's quota. */
+  if (!t->edf)
+    {
+      g->total++;
+      if (g->quota != 0 && ++g->used >= g->quota && !g->throttled)
+        {
+          g->throttled = true;
+          g->throttles++;
+        }
+      if (group_throttled (t))
+        intr_yield_on_return ();
+    }
+
+  /* An EDF thread runs until it blocks, is preempted by an
+     earlier deadline, or uses up its budget, in which case it is
+     throttled until its next release. */
+  if (t->edf)
+    {
+      if (--t->edf_budget <= 0)
+        {
+          t->edf_waiting = true;
+          intr_yield_on_return ();
+        }
+      return;
+    }
+
+  /* Enforce preemption.  A thread that uses up its slice is
+     clearly not waiting on I/O, so it loses any wakeup boost. */
+  if (++thread_ticks >= time_slice (t))
+    {
+      set_boost (t, 0);
+      intr_yield_on_return ();
+    }
+}
+
+/* Returns the length of T's time slice, in timer ticks, which
+   scales linearly with T's priority from thread_slice_max at
+   PRI_MIN down to thread_slice_min at PRI_MAX. */
+static unsigned
+time_slice (const struct thread *t)
+{
+  unsigned range = PRI_MAX - PRI_MIN;
+  unsigned spread = thread_slice_max - thread_slice_min;
+
+  return thread_slice_max
+         - (spread * (t->priority - PRI_MIN) + range / 2) / range;
+}
+
+/* Sets T's wakeup boost to BOOST and recomputes its priority. */
+static void
+set_boost (struct thread *t, int boost)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (t->boost == boost || is_idle (t))
+    return;
+  t->boost = boost;
+  if (thread_mlfqs)
+    mlfqs_update_priority (t);
+  else
+    thread_refresh_priority (t);
+}
+
+/* Called by the timer code with interrupts off to account for
+   TICKS timer ticks during which the CPU sat idle with the
+   periodic tick stopped.  timer_ticks() already includes them. */
+void
+thread_tick_idle (int64_t ticks)
+{
+  int64_t now = timer_ticks ();
+  int64_t seconds;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  idle_ticks += ticks;
+  if (thread_mlfqs)
+    for (seconds = now / TIMER_FREQ - (now - ticks) / TIMER_FREQ;
+         seconds > 0; seconds--)
+      mlfqs_second ();
+}
+
+/* Charges the time T has been running since its last accounting
+   point, which ends at NOW, to user or kernel mode. */
+static void
+charge_running (struct thread *t, uint64_t now)
+{
+  if (t->in_user)
+    t->user_cycles += now - t->acct_stamp;
+  else
+    t->kernel_cycles += now - t->acct_stamp;
+  t->acct_stamp = now;
+}
+
+/* Called when the running thread enters the kernel on behalf of
+   its user process, e.g. at the start of a system call. */
+void
+thread_enter_kernel (void)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level = intr_disable ();
+
+  charge_running (cur, rdtsc ());
+  cur->in_user = false;
+  intr_set_level (old_level);
+}
+
+/* Called when the running thread is about to return to user
+   mode. */
+void
+thread_enter_user (void)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level = intr_disable ();
+
+  charge_running (cur, rdtsc ());
+  cur->in_user = true;
+  intr_set_level (old_level);
+}
+
+/* A copy of one thread's statistics, taken so that they can be
+   printed with interrupts on. */
+struct thread_stats
+  {
+    struct thread *thread;
+    tid_t tid;
+    char name[16];
+    enum thread_status status;
+    int priority;
+    uint64_t user_cycles, kernel_cycles, wait_cycles;
+    uint64_t last_run;
+    unsigned voluntary_switches, involuntary_switches;
+    bool edf;
+    int64_t edf_period, edf_runtime, edf_rel_deadline;
+    unsigned edf_misses;
+    int tickets;
+    size_t kstack_used, kstack_size;
+  };
+
+/* Compares the CPU share each of the CNT threads in STATS asked
+   for with its tickets against the share it actually got, for
+   judging the fairness of the stride policy.  Only threads
+   still alive are counted, and each over its whole lifetime. */
+static void
+print_stride_shares (const struct thread_stats *stats, size_t cnt)
+{
+  uint64_t total_cycles = 0;
+  long long total_tickets = 0;
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    if (stats[i].tickets > 0)
+      {
+        total_cycles += stats[i].user_cycles + stats[i].kernel_cycles;
+        total_tickets += stats[i].tickets;
+      }
+  if (total_cycles == 0 || total_tickets == 0)
+    return;
+
+  printf ("%5s %-16s %7s %10s %10s\n",
+          "tid", "name", "tickets", "asked(%)", "got(%)");
+  for (i = 0; i < cnt; i++)
+    {
+      const struct thread_stats *s = &stats[i];
+      uint64_t cycles = s->user_cycles + s->kernel_cycles;
+
+      if (s->tickets > 0)
+        printf ("%5d %-16s %7d %10lld %10llu\n", s->tid, s->name,
+                s->tickets, s->tickets * 100LL / total_tickets,
+                cycles * 100 / total_cycles);
+    }
 }
 
-/* Prints thread statistics. */
+/* Prints thread statistics: the global tick counts, then the
+   time each thread has spent running in user and kernel mode and
+   waiting to run, and how often it gave up the CPU. */
 void
 thread_print_stats (void) 
 {
+  static const char *status_names[] = {"run", "ready", "block", "dying"};
+  struct thread_stats *stats;
+  struct list_elem *e;
+  enum intr_level old_level;
+  uint64_t now;
+  size_t cnt, i;
+
   printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
           idle_ticks, kernel_ticks, user_ticks);
+  printf ("Scheduler: %lld context switches (%lld/s), "
+          "wakeup-to-run latency %llu us average, %llu us max\n",
+          switch_cnt, switch_cnt * TIMER_FREQ / (timer_ticks () + 1),
+          wakeup_cnt != 0 ? timer_cycles_to_us (wakeup_cycles / wakeup_cnt) : 0,
+          timer_cycles_to_us (wakeup_max));
+  printf ("Run queue: %d ready\n", ready_rq.cnt);
+
+  /* Keep the reaper from freeing any thread in the snapshot
+     until we have scanned its stack. */
+  lock_acquire (&reap_lock);
+
+  /* Size the snapshot under the lock, and try again if more
+     threads were created while we allocated it. */
+  for (;;)
+    {
+      old_level = spinlock_acquire (&all_lock);
+      cnt = thread_cnt;
+      spinlock_release (&all_lock, old_level);
+
+      stats = malloc (cnt * sizeof *stats);
+      if (stats == NULL)
+        {
+          lock_release (&reap_lock);
+          return;
+        }
+
+      old_level = spinlock_acquire (&all_lock);
+      if (thread_cnt <= (int) cnt)
+        break;
+      spinlock_release (&all_lock, old_level);
+      free (stats);
+    }
+
+  /* Take a consistent snapshot, including the time the running
+     thread has not been charged for yet. */
+  now = rdtsc ();
+  charge_running (thread_current (), now);
+  for (i = 0, e = list_begin (&all_list);
+       i < cnt && e != list_end (&all_list); i++, e = list_next (e))
+    {
+      struct thread *t = list_entry (e, struct thread, allelem);
+      struct thread_stats *s = &stats[i];
+
+      s->thread = t;
+      s->tid = t->tid;
+      strlcpy (s->name, t->name, sizeof s->name);
+      s->status = t->status;
+      s->priority = t->priority;
+      s->user_cycles = t->user_cycles;
+      s->kernel_cycles = t->kernel_cycles;
+      s->wait_cycles = t->wait_cycles;
+      if (t->status == THREAD_READY)
+        s->wait_cycles += now - t->acct_stamp;
+      s->last_run = t->last_run;
+      s->voluntary_switches = t->voluntary_switches;
+      s->involuntary_switches = t->involuntary_switches;
+      s->edf = t->edf;
+      s->edf_period = t->edf_period;
+      s->edf_runtime = t->edf_runtime;
+      s->edf_rel_deadline = t->edf_rel_deadline;
+      s->edf_misses = t->edf_misses;
+      s->tickets = !is_idle (t) ? t->tickets : 0;
+      s->kstack_size = t->kstack != NULL ? t->kstack_top - t->kstack : 0;
+    }
+  cnt = i;
+  spinlock_release (&all_lock, old_level);
+
+  /* Scanning the stacks takes a while, so do it with interrupts
+     on.  The reaper is held off, so every thread is still there,
+     although it may have exited since. */
+  for (i = 0; i < cnt; i++)
+    stats[i].kstack_used = stats[i].thread->kstack_max
+      = kstack_usage (stats[i].thread);
+  lock_release (&reap_lock);
+
+  printf ("%5s %-16s %-5s %3s %12s %12s %12s %7s %7s %12s %13s\n",
+          "tid", "name", "state", "pri", "user(us)", "kernel(us)",
+          "wait(us)", "vol", "invol", "idle(us)", "stack(bytes)");
+  for (i = 0; i < cnt; i++)
+    {
+      struct thread_stats *s = &stats[i];
+
+      printf ("%5d %-16s %-5s %3d %12llu %12llu %12llu %7u %7u %12llu",
+              s->tid, s->name, status_names[s->status], s->priority,
+              timer_cycles_to_us (s->user_cycles),
+              timer_cycles_to_us (s->kernel_cycles),
+              timer_cycles_to_us (s->wait_cycles),
+              s->voluntary_switches, s->involuntary_switches,
+              s->status == THREAD_RUNNING
+              ? 0 : timer_cycles_to_us (now - s->last_run));
+      if (s->kstack_size != 0)
+        printf (" %6zu/%-6zu\n", s->kstack_used, s->kstack_size);
+      else
+        printf (" %13s\n", "-");
+    }
+  printf ("Kernel stacks: %u pages each, deepest use by an exited thread "
+          "%zu bytes (%s)\n", thread_kstack_pages, kstack_peak,
+          kstack_peak != 0 ? kstack_peak_name : "none");
+  for (i = 0; i < cnt; i++)
+    {
+      struct thread_stats *s = &stats[i];
+
+      if (s->edf)
+        printf ("EDF %d: period %lld, runtime %lld, deadline %lld ticks, "
+                "%u deadline misses\n", s->tid, s->edf_period,
+                s->edf_runtime, s->edf_rel_deadline, s->edf_misses);
+    }
+  if (sched_policy == &stride_policy)
+    print_stride_shares (stats, cnt);
+  free (stats);
+}
+
+/* Context switch benchmark.  thread_switch_bench() has two
+   threads at PRI_DEFAULT + 1 hand the CPU back and forth with
+   thread_yield() SWITCH_ROUNDS times each, while filler threads
+   sit ready below them, spread over PRI_MIN to PRI_DEFAULT - 1
+   so that they occupy many of the run queue's priorities.  It
+   reports the cost of one switch with 5, 50 and 500 threads
+   ready, which should not grow with the count.  Stops creating
+   fillers early if memory runs out. */
+#define SWITCH_ROUNDS 10000
+static const int switch_bench_ready[] = {5, 50, 500};
+static struct semaphore switch_bench_done;
+static volatile bool switch_bench_stop;
+static uint64_t switch_bench_end;
+
+/* Runs the context switch benchmark and prints its results. */
+void
+thread_switch_bench (void)
+{
+  size_t i;
+
+  if (thread_mlfqs || sched_policy != &priority_policy)
+    {
+      printf ("switchbench: needs the priority scheduler\n");
+      return;
+    }
+  sema_init (&switch_bench_done, 0);
+  for (i = 0; i < sizeof switch_bench_ready / sizeof *switch_bench_ready;
+       i++)
+    switch_bench_measure (switch_bench_ready[i]);
+}
+
+/* Measures the cost of a context switch with READY threads
+   ready to run, and prints it. */
+static void
+switch_bench_measure (int ready)
+{
+  int base_priority = thread_current ()->base_priority;
+  int fillers, pingers, i;
+  uint64_t start;
+
+  /* Stay above the threads we create until we wait for them. */
+  thread_set_priority (PRI_MAX);
+  switch_bench_stop = false;
+  for (fillers = 0; fillers < ready - 1; fillers++)
+    if (thread_create ("filler", PRI_MIN + fillers % (PRI_DEFAULT - PRI_MIN),
+                       switch_bench_filler, NULL) == TID_ERROR)
+      break;
+  for (pingers = 0; pingers < 2; pingers++)
+    if (thread_create ("pinger", PRI_DEFAULT + 1, switch_bench_pinger,
+                       NULL) == TID_ERROR)
+      break;
+
+  start = rdtsc ();
+  for (i = 0; i < pingers; i++)
+    sema_down (&switch_bench_done);
+  if (pingers == 2)
+    printf ("%3d ready: %llu cycles/switch\n", fillers + 1,
+            (switch_bench_end - start) / (2 * SWITCH_ROUNDS));
+  else
+    printf ("switchbench: out of memory\n");
+
+  switch_bench_stop = true;
+  for (i = 0; i < fillers; i++)
+    sema_down (&switch_bench_done);
+  thread_set_priority (base_priority);
+}
+
+/* A thread for switch_bench_measure() that yields to its twin
+   SWITCH_ROUNDS times. */
+static void
+switch_bench_pinger (void *aux UNUSED)
+{
+  int i;
+
+  for (i = 0; i < SWITCH_ROUNDS; i++)
+    thread_yield ();
+  switch_bench_end = rdtsc ();
+  sema_up (&switch_bench_done);
+}
+
+/* A thread for switch_bench_measure() that stays ready below the
+   pingers until the measurement is over. */
+static void
+switch_bench_filler (void *aux UNUSED)
+{
+  while (!switch_bench_stop)
+    thread_yield ();
+  sema_up (&switch_bench_done);
+}
+
+/* Deadline benchmark.  thread_edf_bench() runs the periodic EDF
+   tasks in edf_bench_tasks for EDF_BENCH_TICKS ticks, first on
+   their own and then next to EDF_BENCH_LOAD CPU-bound threads at
+   PRI_MAX, and prints how many jobs each task completed and how
+   many missed their deadlines.  The tasks reserve 70% of the
+   CPU, and each job uses all but one tick of its budget.  Since
+   the EDF class sits above the priority classes, the load should
+   not cause any misses. */
+#define EDF_BENCH_TICKS 1000
+#define EDF_BENCH_LOAD 4
+
+/* A periodic task for the deadline benchmark. */
+struct edf_bench_task
+  {
+    int64_t period, runtime, deadline;  /* In timer ticks. */
+    bool admitted;                      /* Accepted by admission control? */
+    int jobs;                           /* Jobs completed. */
+    unsigned misses;                    /* Deadlines missed. */
+  };
+
+static struct edf_bench_task edf_bench_tasks[] =
+  {
+    {10, 2, 10, false, 0, 0},
+    {20, 5, 15, false, 0, 0},
+    {50, 10, 40, false, 0, 0},
+  };
+#define EDF_BENCH_TASKS (sizeof edf_bench_tasks / sizeof *edf_bench_tasks)
+static struct semaphore edf_bench_done;
+static volatile bool edf_bench_stop;
+
+/* Runs the deadline benchmark and prints its results. */
+void
+thread_edf_bench (void)
+{
+  int base_priority = thread_current ()->base_priority;
+
+  /* Keep up with the load so as to stop it on time. */
+  thread_set_priority (PRI_MAX);
+  sema_init (&edf_bench_done, 0);
+  edf_bench_run (false);
+  edf_bench_run (true);
+  thread_set_priority (base_priority);
+}
+
+/* Runs the EDF tasks for EDF_BENCH_TICKS, next to the CPU-bound
+   load if LOADED, and prints their deadline misses. */
+static void
+edf_bench_run (bool loaded)
+{
+  const char *label = loaded ? "loaded" : "alone";
+  int threads = 0;
+  size_t i;
+
+  edf_bench_stop = false;
+  for (i = 0; i < EDF_BENCH_TASKS; i++)
+    if (thread_create ("edf", PRI_MAX, edf_bench_task,
+                       &edf_bench_tasks[i]) != TID_ERROR)
+      threads++;
+  for (i = 0; loaded && i < EDF_BENCH_LOAD; i++)
+    if (thread_create ("load", PRI_MAX, edf_bench_load, NULL) != TID_ERROR)
+      threads++;
+
+  timer_sleep (EDF_BENCH_TICKS);
+  edf_bench_stop = true;
+  while (threads-- > 0)
+    sema_down (&edf_bench_done);
+
+  for (i = 0; i < EDF_BENCH_TASKS; i++)
+    {
+      struct edf_bench_task *task = &edf_bench_tasks[i];
+
+      if (task->admitted)
+        printf ("%-6s task %zu: period %lld, runtime %lld, deadline %lld "
+                "ticks: %d jobs, %u missed\n", label, i, task->period,
+                task->runtime, task->deadline, task->jobs, task->misses);
+      else
+        printf ("%-6s task %zu: not admitted\n", label, i);
+    }
+}
+
+/* An EDF task for edf_bench_run(), described by TASK_.  Runs jobs
+   until the benchmark stops, then leaves the EDF class. */
+static void
+edf_bench_task (void *task_)
+{
+  struct edf_bench_task *task = task_;
+  struct thread *cur = thread_current ();
+
+  task->jobs = 0;
+  task->misses = 0;
+  task->admitted = thread_set_deadline (task->period, task->runtime,
+                                        task->deadline);
+  if (task->admitted)
+    {
+      for (;;)
+        {
+          while (cur->edf_budget > 1 && !edf_bench_stop)
+            barrier ();
+          if (edf_bench_stop)
+            break;
+          task->jobs++;
+          thread_yield_job ();
+        }
+      task->misses = cur->edf_misses;
+      thread_set_deadline (0, 0, 0);
+    }
+  sema_up (&edf_bench_done);
+}
+
+/* A CPU-bound thread for edf_bench_run(). */
+static void
+edf_bench_load (void *aux UNUSED)
+{
+  while (!edf_bench_stop)
+    barrier ();
+  sema_up (&edf_bench_done);
+}
+
+/* Fairness benchmark for the stride policy.
+   thread_stride_bench() runs one spinning thread for each entry
+   in stride_bench_tickets, holding that many tickets, and after
+   a short warmup measures the CPU time each gets over
+   STRIDE_BENCH_TICKS ticks.  It prints the share of the CPU each
+   asked for with its tickets next to the share it got, and the
+   largest difference, all in tenths of a percent. */
+#define STRIDE_BENCH_TICKS 1000
+#define STRIDE_BENCH_WARMUP 10
+static const int stride_bench_tickets[] = {100, 200, 300, 400};
+#define STRIDE_BENCH_THREADS \
+  (sizeof stride_bench_tickets / sizeof *stride_bench_tickets)
+static struct thread *stride_bench_threads[STRIDE_BENCH_THREADS];
+static struct semaphore stride_bench_done;
+static volatile bool stride_bench_stop;
+
+/* Runs the fairness benchmark and prints its results. */
+void
+thread_stride_bench (void)
+{
+  uint64_t start[STRIDE_BENCH_THREADS], end[STRIDE_BENCH_THREADS];
+  uint64_t total_cycles = 0;
+  int total_tickets = 0, max_error = 0;
+  size_t threads, i;
+
+  if (sched_policy != &stride_policy)
+    {
+      printf ("stridebench: needs the stride scheduler (-sched=stride)\n");
+      return;
+    }
+
+  sema_init (&stride_bench_done, 0);
+  stride_bench_stop = false;
+  for (threads = 0; threads < STRIDE_BENCH_THREADS; threads++)
+    {
+      stride_bench_threads[threads] = NULL;
+      if (thread_create ("spinner", PRI_DEFAULT, stride_bench_spinner,
+                         (void *) threads) == TID_ERROR)
+        break;
+    }
+
+  if (threads == STRIDE_BENCH_THREADS)
+    {
+      /* Let every spinner start and take its tickets. */
+      timer_sleep (STRIDE_BENCH_WARMUP);
+      stride_bench_snapshot (start);
+      timer_sleep (STRIDE_BENCH_TICKS);
+      stride_bench_snapshot (end);
+    }
+  stride_bench_stop = true;
+  for (i = 0; i < threads; i++)
+    sema_down (&stride_bench_done);
+  if (threads < STRIDE_BENCH_THREADS)
+    {
+      printf ("stridebench: out of memory\n");
+      return;
+    }
+
+  for (i = 0; i < STRIDE_BENCH_THREADS; i++)
+    {
+      total_cycles += end[i] - start[i];
+      total_tickets += stride_bench_tickets[i];
+    }
+  for (i = 0; i < STRIDE_BENCH_THREADS; i++)
+    {
+      int requested = stride_bench_tickets[i] * 1000 / total_tickets;
+      int achieved = total_cycles != 0
+                     ? (end[i] - start[i]) * 1000 / total_cycles : 0;
+      int error = achieved > requested ? achieved - requested
+                                       : requested - achieved;
+
+      printf ("%5d tickets: requested %3d.%d%%, achieved %3d.%d%%\n",
+              stride_bench_tickets[i], requested / 10, requested % 10,
+              achieved / 10, achieved % 10);
+      if (error > max_error)
+        max_error = error;
+    }
+  printf ("Largest error: %d.%d%% over %d ticks\n",
+          max_error / 10, max_error % 10, STRIDE_BENCH_TICKS);
+}
+
+/* Stores in CYCLES[] the CPU time each spinner has used so far.
+   The spinners are not running while we are, so all of their
+   time has been charged. */
+static void
+stride_bench_snapshot (uint64_t cycles[])
+{
+  enum intr_level old_level = intr_disable ();
+  size_t i;
+
+  for (i = 0; i < STRIDE_BENCH_THREADS; i++)
+    {
+      struct thread *t = stride_bench_threads[i];
+      cycles[i] = t != NULL ? t->user_cycles + t->kernel_cycles : 0;
+    }
+  intr_set_level (old_level);
+}
+
+/* A thread for thread_stride_bench() that takes the tickets at
+   index IDX_ in stride_bench_tickets and spins until the
+   benchmark stops. */
+static void
+stride_bench_spinner (void *idx_)
+{
+  size_t idx = (size_t) idx_;
+
+  thread_set_tickets (stride_bench_tickets[idx]);
+  stride_bench_threads[idx] = thread_current ();
+  while (!stride_bench_stop)
+    barrier ();
+  sema_up (&stride_bench_done);
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -159,11 +1023,9 @@ thread_print_stats (void)
    before thread_create() returns.  Contrariwise, the original
    thread may run for any amount of time before the new thread is
    scheduled.  Use a semaphore or some other form of
-   synchronization if you need to ensure ordering.
-
-   The code provided sets the new thread's `priority' member to
-   PRIORITY, but no actual priority scheduling is implemented.
-   Priority scheduling is the goal of Problem 1-3. */
+   synchronization if you need to ensure ordering.  If the new
+   thread has a higher priority than the running thread, the
+   running thread yields to it immediately. */
 tid_t
 thread_create (const char *name, int priority,
                thread_func *function, void *aux) 
@@ -172,23 +1034,34 @@ thread_create (const char *name, int priority,
   struct kernel_thread_frame *kf;
   struct switch_entry_frame *ef;
   struct switch_threads_frame *sf;
+  uint8_t *kstack;
   tid_t tid;
 
   ASSERT (function != NULL);
 
-  /* Allocate thread. */
+  if (!thread_cnt_reserve ())
+    return TID_ERROR;
+
+  /* Allocate thread and its kernel stack. */
   t = palloc_get_page (PAL_ZERO);
   if (t == NULL)
-    return TID_ERROR;
+    {
+      thread_cnt_release ();
+      return TID_ERROR;
+    }
+  kstack = kstack_alloc ();
+  if (kstack == NULL)
+    {
+      palloc_free_page (t);
+      thread_cnt_release ();
+      return TID_ERROR;
+    }
 
   /* Initialize thread. */
   init_thread (t, name, priority);
+  t->kstack = kstack;
+  t->kstack_top = t->stack = kstack + thread_kstack_pages * PGSIZE;
   tid = t->tid = allocate_tid ();
-#ifdef USERPROG
-  int i;
-  for (i = 0; i < MAX_FD; i++)
-    t->fd[i] = NULL;
-#endif
 
   /* Stack frame for kernel_thread(). */
   kf = alloc_frame (t, sizeof *kf);
@@ -206,8 +1079,27 @@ thread_create (const char *name, int priority,
   sf->ebp = 0;
 
   t->md = init_child_metadata (tid);
+  if (t->md == NULL)
+    {
+      enum intr_level old_level;
+
+      lock_acquire (&reap_lock);
+      old_level = spinlock_acquire (&all_lock);
+      list_remove (&t->allelem);
+      t->group->members--;
+      spinlock_release (&all_lock, old_level);
+      kstack_free (t);
+      palloc_free_page (t);
+      lock_release (&reap_lock);
+      thread_cnt_release ();
+      return TID_ERROR;
+    }
+  t->md->thread = t;
+  trace_event (TRACE_CREATE, t, thread_current ());
+
   /* Add to run queue. */
   thread_unblock (t);
+  thread_preempt ();
 
   return tid;
 }
@@ -224,6 +1116,8 @@ thread_block (void)
   ASSERT (!intr_context ());
   ASSERT (intr_get_level () == INTR_OFF);
 
+  trace_event (TRACE_BLOCK, thread_current (), NULL);
+  set_boost (thread_current (), 0);
   thread_current ()->status = THREAD_BLOCKED;
   schedule ();
 }
@@ -232,10 +1126,13 @@ thread_block (void)
    This is an error if T is not blocked.  (Use thread_yield() to
    make the running thread ready.)
 
-   This function does not preempt the running thread.  This can
-   be important: if the caller had disabled interrupts itself,
-   it may expect that it can atomically unblock a thread and
-   update other data. */
+   Outside of an interrupt handler, this function does not
+   preempt the running thread.  This can be important: if the
+   caller had disabled interrupts itself, it may expect that it
+   can atomically unblock a thread and update other data.  Such
+   callers should call thread_preempt() once they are done.
+   Within an interrupt handler, a yield is requested on return
+   from the interrupt if T outranks the running thread. */
 void
 thread_unblock (struct thread *t) 
 {
@@ -245,8 +1142,19 @@ thread_unblock (struct thread *t)
 
   old_level = intr_disable ();
   ASSERT (t->status == THREAD_BLOCKED);
-  list_push_back (&ready_list, &t->elem);
+  if (thread_mlfqs)
+    {
+      mlfqs_catch_up (t);
+      mlfqs_update_priority (t);
+    }
+  set_boost (t, thread_wake_boost);
+  ready_queue_push (t);
   t->status = THREAD_READY;
+  t->acct_stamp = rdtsc ();
+  t->woken = true;
+  trace_event (TRACE_WAKEUP, t, running_thread ());
+  if (intr_context ())
+    thread_preempt ();
   intr_set_level (old_level);
 }
 
@@ -266,10 +1174,11 @@ thread_current (void)
   struct thread *t = running_thread ();
   
   /* Make sure T is really a thread.
-     If either of these assertions fire, then your thread may
-     have overflowed its stack.  Each thread has less than 4 kB
-     of stack, so a few big automatic arrays or moderate
-     recursion can cause stack overflow. */
+     If either of these assertions fire, then the struct thread
+     has been corrupted.  Created threads' stacks no longer share
+     its page, so an overflow runs into the guard page below the
+     stack instead, but the initial thread still runs on the
+     loader's stack within its page. */
   ASSERT (is_thread (t));
   ASSERT (t->status == THREAD_RUNNING);
 
@@ -288,18 +1197,38 @@ thread_tid (void)
 void
 thread_exit (void) 
 {
+  struct thread *cur;
+
   ASSERT (!intr_context ());
 
 #ifdef USERPROG
   process_exit ();
 #endif
+  release_children (thread_current ());
+  thread_release_metadata (thread_current ()->md);
+  thread_current ()->md = NULL;
 
   /* Remove thread from all threads list, set our status to dying,
      and schedule another process.  That process will destroy us
-     when it calls thread_schedule_tail(). */
+     when it calls thread_schedule_tail().  Anyone still donating
+     to us must not be left pointing at our soon-to-be-freed
+     struct thread. */
   intr_disable ();
-  list_remove (&thread_current()->allelem);
-  thread_current ()->status = THREAD_DYING;
+  cur = thread_current ();
+  spinlock_acquire (&all_lock);
+  list_remove (&cur->allelem);
+  thread_cnt--;
+  spinlock_release (&all_lock, INTR_OFF);
+  cur->group->members--;
+  edf_leave (cur);
+  while (!list_empty (&cur->donors))
+    {
+      struct thread *donor = list_entry (list_pop_front (&cur->donors),
+                                         struct thread, donor_elem);
+      donor->donee = NULL;
+    }
+  trace_event (TRACE_EXIT, cur, NULL);
+  cur->status = THREAD_DYING;
   schedule ();
   NOT_REACHED ();
 }
@@ -315,13 +1244,57 @@ thread_yield (void)
   ASSERT (!intr_context ());
 
   old_level = intr_disable ();
-  if (cur != idle_thread) 
-    list_push_back (&ready_list, &cur->elem);
-  cur->status = THREAD_READY;
+  trace_event (TRACE_YIELD, cur, NULL);
+  if (cur->edf_waiting)
+    {
+      /* Throttled by thread_tick() until edf_release(). */
+      cur->status = THREAD_BLOCKED;
+    }
+  else if (group_throttled (cur))
+    group_park (cur);
+  else
+    {
+      if (!is_idle (cur)) 
+        ready_queue_push (cur);
+      cur->status = THREAD_READY;
+    }
   schedule ();
   intr_set_level (old_level);
 }
 
+/* Yields the CPU if a ready thread has a higher priority than
+   the running thread.  Within an interrupt handler, the yield is
+   deferred until the handler returns.  Outside of one, nothing
+   happens if interrupts are disabled, because the caller is then
+   relying on not being preempted. */
+void
+thread_preempt (void)
+{
+  struct thread *cur = running_thread ();
+  struct runqueue *rq;
+  enum intr_level old_level;
+  bool yield;
+
+  old_level = intr_disable ();
+  rq = &ready_rq;
+  spinlock_acquire (&rq->lock);
+  if (is_idle (cur))
+    yield = rq->cnt != 0;
+  else if (!list_empty (&rq->edf))
+    yield = !cur->edf || list_entry (list_front (&rq->edf), struct thread,
+                                     elem)->edf_deadline < cur->edf_deadline;
+  else
+    yield = !cur->edf && sched_policy->preempts (rq, cur);
+  spinlock_release (&rq->lock, old_level);
+
+  if (!yield)
+    return;
+  if (intr_context ())
+    intr_yield_on_return ();
+  else if (old_level == INTR_ON)
+    thread_yield ();
+}
+
 /* Invoke function 'func' on all threads, passing along 'aux'.
    This function must be called with interrupts off. */
 void
@@ -331,57 +1304,619 @@ thread_foreach (thread_action_func *func, void *aux)
 
   ASSERT (intr_get_level () == INTR_OFF);
 
+  spinlock_acquire (&all_lock);
   for (e = list_begin (&all_list); e != list_end (&all_list);
        e = list_next (e))
     {
       struct thread *t = list_entry (e, struct thread, allelem);
       func (t, aux);
     }
+  spinlock_release (&all_lock, INTR_OFF);
 }
 
-/* Sets the current thread's priority to NEW_PRIORITY. */
+/* Sets the current thread's base priority to NEW_PRIORITY.  The
+   effective priority stays raised while other threads donate a
+   higher one.  Yields if the current thread no longer has the
+   highest priority.  Ignored under the multi-level feedback
+   queue scheduler, which computes priorities itself. */
 void
 thread_set_priority (int new_priority) 
 {
-  thread_current ()->priority = new_priority;
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (PRI_MIN <= new_priority && new_priority <= PRI_MAX);
+
+  if (thread_mlfqs)
+    return;
+  old_level = intr_disable ();
+  cur->base_priority = new_priority;
+  thread_refresh_priority (cur);
+  intr_set_level (old_level);
+  thread_preempt ();
 }
 
-/* Returns the current thread's priority. */
-int
-thread_get_priority (void) 
+/* Makes DONOR, which is about to block waiting on DONEE (to
+   release a lock or to exit), donate its priority to DONEE.
+   DONOR must not already be donating.  Must be called with
+   interrupts off. */
+void
+thread_donate (struct thread *donor, struct thread *donee)
 {
-  return thread_current ()->priority;
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (donor->donee == NULL);
+  ASSERT (donor != donee);
+
+  if (thread_mlfqs)
+    return;
+  donor->donee = donee;
+  list_push_back (&donee->donors, &donor->donor_elem);
+  thread_refresh_priority (donee);
 }
 
-/* Sets the current thread's nice value to NICE. */
+/* Withdraws DONOR's priority donation, if any.  Must be called
+   with interrupts off. */
 void
-thread_set_nice (int nice UNUSED) 
+thread_undonate (struct thread *donor)
 {
-  /* Not yet implemented. */
+  struct thread *donee = donor->donee;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (donee == NULL)
+    return;
+  list_remove (&donor->donor_elem);
+  donor->donee = NULL;
+  thread_refresh_priority (donee);
 }
 
-/* Returns the current thread's nice value. */
-int
-thread_get_nice (void) 
+/* Recomputes T's effective priority as the highest of its base
+   priority and the priorities of the threads donating to it.  If
+   that changes it and T is itself donating to another thread,
+   the change is passed along the chain of donees, at most
+   DONATION_DEPTH threads deep.  Must be called with interrupts
+   off. */
+void
+thread_refresh_priority (struct thread *t)
 {
-  /* Not yet implemented. */
-  return 0;
+  int depth;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (thread_mlfqs)
+    return;
+  for (depth = 0; t != NULL && depth < DONATION_DEPTH; depth++)
+    {
+      int priority = t->base_priority + t->boost;
+      struct list_elem *e;
+
+      if (priority > PRI_MAX)
+        priority = PRI_MAX;
+      for (e = list_begin (&t->donors); e != list_end (&t->donors);
+           e = list_next (e))
+        {
+          struct thread *donor = list_entry (e, struct thread, donor_elem);
+          if (donor->priority > priority)
+            priority = donor->priority;
+        }
+      if (priority == t->priority)
+        break;
+      set_effective_priority (t, priority);
+      t = t->donee;
+    }
 }
 
-/* Returns 100 times the system load average. */
-int
-thread_get_load_avg (void) 
+/* Returns T's share of the CPU, in parts per EDF_UTIL_SCALE. */
+static int64_t
+edf_utilization (const struct thread *t)
 {
-  /* Not yet implemented. */
-  return 0;
+  return t->edf_runtime * EDF_UTIL_SCALE / t->edf_period;
 }
 
-/* Returns 100 times the current thread's recent_cpu value. */
-int
-thread_get_recent_cpu (void) 
+/* Returns true if EDF thread A's deadline is earlier than B's. */
+static bool
+edf_earlier (const struct list_elem *a_, const struct list_elem *b_,
+             void *aux UNUSED)
 {
-  /* Not yet implemented. */
-  return 0;
+  const struct thread *a = list_entry (a_, struct thread, elem);
+  const struct thread *b = list_entry (b_, struct thread, elem);
+
+  return a->edf_deadline < b->edf_deadline;
+}
+
+/* Timer event function that releases the next job of EDF thread
+   T: refills its budget, sets its new deadline, and wakes it if
+   it was waiting for the release.  A job still unfinished when
+   the next one is released has missed its deadline. */
+static void
+edf_release (void *t_)
+{
+  struct thread *t = t_;
+
+  if (!t->edf_job_done)
+    t->edf_misses++;
+  t->edf_job_done = false;
+  t->edf_budget = t->edf_runtime;
+  t->edf_deadline = t->edf_release + t->edf_rel_deadline;
+  t->edf_release += t->edf_period;
+  timer_event_add (&t->edf_timer, t->edf_release);
+
+  if (t->status == THREAD_READY)
+    {
+      /* Move to the right place for the new deadline. */
+      struct runqueue *rq = &ready_rq;
+      enum intr_level old_level = spinlock_acquire (&rq->lock);
+
+      rq_remove (rq, t);
+      rq_push (rq, t);
+      spinlock_release (&rq->lock, old_level);
+    }
+  if (t->edf_waiting)
+    {
+      t->edf_waiting = false;
+      if (t->status == THREAD_BLOCKED)
+        thread_unblock (t);
+    }
+}
+
+/* Takes T out of the EDF class.  Must be called with interrupts
+   off, while T is not in the run queue. */
+static void
+edf_leave (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (t->status != THREAD_READY);
+
+  if (!t->edf)
+    return;
+  timer_event_cancel (&t->edf_timer);
+  edf_util -= edf_utilization (t);
+  t->edf = false;
+  t->edf_waiting = false;
+}
+
+/* Moves the current thread into the earliest-deadline-first
+   class: from now on, once every PERIOD ticks it is released to
+   run for up to RUNTIME ticks, which must complete within
+   DEADLINE ticks of the release.  Requires 0 < RUNTIME <=
+   DEADLINE <= PERIOD.  A PERIOD of 0 moves the thread back to
+   the priority classes.
+
+   Returns false, leaving the thread as it was, if the
+   parameters are invalid or admitting the thread would raise
+   the total EDF utilization above 100%. */
+bool
+thread_set_deadline (int64_t period, int64_t runtime, int64_t deadline)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+  int64_t util, old_util;
+
+  if (period != 0
+      && (runtime <= 0 || runtime > deadline || deadline > period))
+    return false;
+
+  old_level = intr_disable ();
+  old_util = cur->edf ? edf_utilization (cur) : 0;
+  util = period != 0 ? runtime * EDF_UTIL_SCALE / period : 0;
+  if (edf_util - old_util + util > EDF_UTIL_SCALE)
+    {
+      intr_set_level (old_level);
+      return false;
+    }
+
+  edf_leave (cur);
+  if (period != 0)
+    {
+      cur->edf = true;
+      cur->edf_period = period;
+      cur->edf_runtime = runtime;
+      cur->edf_rel_deadline = deadline;
+      cur->edf_misses = 0;
+      edf_util += util;
+
+      /* The first job is released now. */
+      cur->edf_release = timer_ticks ();
+      cur->edf_job_done = true;
+      timer_event_init (&cur->edf_timer, edf_release, cur);
+      edf_release (cur);
+    }
+  intr_set_level (old_level);
+  thread_preempt ();
+  return true;
+}
+
+/* Called by an EDF thread when its current job is complete.
+   Blocks until the next job is released.  Other threads just
+   yield. */
+void
+thread_yield_job (void)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  if (!cur->edf)
+    {
+      thread_yield ();
+      return;
+    }
+
+  old_level = intr_disable ();
+  if (timer_ticks () > cur->edf_deadline)
+    cur->edf_misses++;
+  cur->edf_job_done = true;
+  cur->edf_waiting = true;
+  thread_block ();
+  intr_set_level (old_level);
+}
+
+/* Returns true if T may not run because its group is out of
+   quota for this period. */
+static bool
+group_throttled (const struct thread *t)
+{
+  return t->group->throttled && !t->edf && !is_idle (t);
+}
+
+/* Parks T, which is running or has just been taken off the run
+   queue, until its group's quota is refilled. */
+static void
+group_park (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  t->status = THREAD_BLOCKED;
+  list_push_back (&t->group->parked, &t->elem);
+}
+
+/* Wakes up all the threads parked in group G. */
+static void
+group_unpark (struct thread_group *g)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (!list_empty (&g->parked))
+    thread_unblock (list_entry (list_pop_front (&g->parked),
+                                struct thread, elem));
+}
+
+/* Timer event function that starts a new period for group G_:
+   refills its quota and lets its parked threads run again. */
+static void
+group_refill (void *g_)
+{
+  struct thread_group *g = g_;
+
+  g->last_used = g->used;
+  g->used = 0;
+  g->throttled = false;
+  timer_event_add (&g->refill, timer_ticks () + g->period);
+  group_unpark (g);
+}
+
+/* Moves the current thread into process group GROUP.  Threads it
+   creates from now on start out in the same group.  Returns
+   false if GROUP is out of range. */
+bool
+thread_set_group (int group)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  if (group < 0 || group >= GROUP_CNT)
+    return false;
+
+  old_level = intr_disable ();
+  cur->group->members--;
+  cur->group = &groups[group];
+  cur->group->members++;
+  intr_set_level (old_level);
+
+  /* The new group may already be out of quota. */
+  if (group_throttled (cur))
+    thread_yield ();
+  return true;
+}
+
+/* Limits process group GROUP to QUOTA ticks of CPU time in each
+   PERIOD ticks, or removes its limit if QUOTA is 0.  Requires 0
+   < QUOTA <= PERIOD.  Returns false if GROUP or the limits are
+   invalid.  Group 0 cannot be limited. */
+bool
+thread_set_group_quota (int group, int64_t quota, int64_t period)
+{
+  struct thread_group *g;
+  enum intr_level old_level;
+
+  if (group <= 0 || group >= GROUP_CNT
+      || (quota != 0 && (quota < 0 || quota > period)))
+    return false;
+
+  g = &groups[group];
+  old_level = intr_disable ();
+  if (g->quota != 0)
+    timer_event_cancel (&g->refill);
+  g->quota = quota;
+  g->period = period;
+  g->used = 0;
+  g->throttled = false;
+  if (quota != 0)
+    {
+      timer_event_init (&g->refill, group_refill, g);
+      timer_event_add (&g->refill, timer_ticks () + period);
+    }
+  group_unpark (g);
+  intr_set_level (old_level);
+  return true;
+}
+
+/* Prints each process group's quota, usage and throttle count. */
+void
+thread_print_groups (void)
+{
+  int i;
+
+  printf ("%5s %7s %7s %7s %10s %10s %9s\n", "group", "members",
+          "quota", "period", "last used", "total", "throttled");
+  for (i = 0; i < GROUP_CNT; i++)
+    {
+      struct thread_group g;
+      enum intr_level old_level;
+
+      old_level = intr_disable ();
+      g = groups[i];
+      intr_set_level (old_level);
+
+      if (g.members == 0 && g.quota == 0 && g.total == 0)
+        continue;
+      if (g.quota != 0)
+        printf ("%5d %7d %7lld %7lld %10lld %10lld %9u\n", g.id, g.members,
+                g.quota, g.period, g.last_used, g.total, g.throttles);
+      else
+        printf ("%5d %7d %7s %7s %10s %10lld %9s\n", g.id, g.members,
+                "-", "-", "-", g.total, "-");
+    }
+}
+
+/* Selects the scheduling policy named NAME for the threads
+   outside the EDF class: "priority" (the default), "mlfqs" or
+   "stride".  Returns false if there is no such policy.  Must be
+   called before thread_init(). */
+bool
+thread_set_policy (const char *name)
+{
+  if (!strcmp (name, "priority"))
+    sched_policy = &priority_policy;
+  else if (!strcmp (name, "mlfqs"))
+    {
+      sched_policy = &priority_policy;
+      thread_mlfqs = true;
+    }
+  else if (!strcmp (name, "stride"))
+    sched_policy = &stride_policy;
+  else
+    return false;
+  return true;
+}
+
+/* Sets the current thread's stride scheduling tickets to
+   TICKETS, which must be between 1 and TICKETS_MAX.  The thread
+   gets CPU time in proportion to its share of all the tickets
+   held by runnable threads.  Only affects scheduling under
+   "-sched=stride". */
+void
+thread_set_tickets (int tickets)
+{
+  ASSERT (tickets >= 1 && tickets <= TICKETS_MAX);
+
+  thread_current ()->tickets = tickets;
+}
+
+/* Returns the current thread's stride scheduling tickets. */
+int
+thread_get_tickets (void)
+{
+  return thread_current ()->tickets;
+}
+
+/* Returns the current thread's priority. */
+int
+thread_get_priority (void) 
+{
+  return thread_current ()->priority;
+}
+
+/* Sets the current thread's nice value to NICE, clamped to
+   NICE_MIN...NICE_MAX, and recomputes its priority.  Yields if
+   the current thread no longer has the highest priority. */
+void
+thread_set_nice (int nice) 
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  if (nice < NICE_MIN)
+    nice = NICE_MIN;
+  else if (nice > NICE_MAX)
+    nice = NICE_MAX;
+
+  old_level = intr_disable ();
+  cur->nice = nice;
+  if (thread_mlfqs)
+    mlfqs_update_priority (cur);
+  intr_set_level (old_level);
+  thread_preempt ();
+}
+
+/* Returns the current thread's nice value. */
+int
+thread_get_nice (void) 
+{
+  return thread_current ()->nice;
+}
+
+/* Returns 100 times the system load average. */
+int
+thread_get_load_avg (void) 
+{
+  enum intr_level old_level;
+  int load;
+
+  old_level = intr_disable ();
+  load = fp_round (load_avg * 100);
+  intr_set_level (old_level);
+  return load;
+}
+
+/* Returns 100 times the current thread's recent_cpu value. */
+int
+thread_get_recent_cpu (void) 
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+  int recent_cpu;
+
+  old_level = intr_disable ();
+  mlfqs_catch_up (cur);
+  recent_cpu = fp_round (cur->recent_cpu * 100);
+  intr_set_level (old_level);
+  return recent_cpu;
+}
+
+/* Applies to T's recent_cpu the once-per-second decay steps it
+   has missed while it was blocked. */
+static void
+mlfqs_catch_up (struct thread *t)
+{
+  int64_t step = t->cpu_epoch;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (decay_epoch - step > DECAY_HISTORY)
+    {
+      int64_t oldest = decay_epoch - DECAY_HISTORY;
+
+      mlfqs_decay_steps (t, decay_history[oldest % DECAY_HISTORY],
+                         oldest - step);
+      step = oldest;
+    }
+  for (; step < decay_epoch; step++)
+    t->recent_cpu = fp_add_int (fp_mul (decay_history[step % DECAY_HISTORY],
+                                        t->recent_cpu), t->nice);
+  t->cpu_epoch = decay_epoch;
+}
+
+/* Applies STEPS decay steps with coefficient COEF to T's
+   recent_cpu.  One step is the map x -> COEF * x + nice; the
+   map for STEPS steps is built by repeated squaring. */
+static void
+mlfqs_decay_steps (struct thread *t, fixed_t coef, int64_t steps)
+{
+  fixed_t a = coef, b = fp_from_int (t->nice);   /* 2^i steps. */
+  fixed_t ra = fp_from_int (1), rb = 0;          /* Steps so far. */
+
+  for (; steps > 0; steps >>= 1)
+    {
+      if (steps & 1)
+        {
+          rb = fp_mul (a, rb) + b;
+          ra = fp_mul (a, ra);
+        }
+      b = fp_mul (a, b) + b;
+      a = fp_mul (a, a);
+    }
+  t->recent_cpu = fp_mul (ra, t->recent_cpu) + rb;
+}
+
+/* Returns the priority that T's recent_cpu and nice values
+   call for. */
+static int
+mlfqs_priority (const struct thread *t)
+{
+  int priority = PRI_MAX - fp_round (t->recent_cpu / 4) - t->nice * 2
+                 + t->boost;
+
+  if (priority < PRI_MIN)
+    return PRI_MIN;
+  else if (priority > PRI_MAX)
+    return PRI_MAX;
+  else
+    return priority;
+}
+
+/* Recomputes T's priority from its recent_cpu and nice values.
+   If T is in the run queue, moves it to the queue for its new
+   priority. */
+static void
+mlfqs_update_priority (struct thread *t)
+{
+  int priority = mlfqs_priority (t);
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (priority != t->priority)
+    set_effective_priority (t, priority);
+}
+
+/* Once-per-second multi-level feedback queue bookkeeping:
+   updates the load average, records this second's recent_cpu
+   decay coefficient, and applies it to the running and ready
+   threads.  Blocked threads are brought up to date lazily by
+   mlfqs_catch_up() when they are unblocked, so the cost here is
+   proportional to the number of runnable threads. */
+static void
+mlfqs_second (void)
+{
+  struct thread *cur = running_thread ();
+  struct runqueue *rq = &ready_rq;
+  int ready_threads = !is_idle (cur);
+  fixed_t twice_load;
+  int priority;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  ready_threads += ready_rq.cnt;
+
+  load_avg = fp_mul (fp_div (fp_from_int (59), fp_from_int (60)), load_avg)
+             + fp_from_int (ready_threads) / 60;
+  twice_load = load_avg * 2;
+  decay_history[decay_epoch % DECAY_HISTORY]
+    = fp_div (twice_load, fp_add_int (twice_load, 1));
+  decay_epoch++;
+
+  if (!is_idle (cur))
+    {
+      mlfqs_catch_up (cur);
+      mlfqs_update_priority (cur);
+    }
+
+  /* Walk the run queues from the highest priority down.  A
+     thread whose priority changes moves to another queue, where
+     it may be visited a second time, but then it is already up to
+     date and stays put. */
+  spinlock_acquire (&rq->lock);
+  for (priority = PRI_MAX; priority >= PRI_MIN; priority--)
+    {
+      struct list *queue = &rq->queues[priority];
+      struct list_elem *e, *next;
+
+      for (e = list_begin (queue); e != list_end (queue); e = next)
+        {
+          struct thread *t = list_entry (e, struct thread, elem);
+          int new_priority;
+
+          next = list_next (e);
+          mlfqs_catch_up (t);
+          new_priority = mlfqs_priority (t);
+          if (new_priority != t->priority)
+            {
+              rq_remove (rq, t);
+              t->priority = new_priority;
+              rq_push (rq, t);
+            }
+        }
+    }
+  spinlock_release (&rq->lock, INTR_OFF);
 }
 
 /* Idle thread.  Executes when no other thread is ready to run.
@@ -391,8 +1926,8 @@ thread_get_recent_cpu (void)
    point it initializes idle_thread, "up"s the semaphore passed
    to it to enable thread_start() to continue, and immediately
    blocks.  After that, the idle thread never appears in the
-   ready list.  It is returned by next_thread_to_run() as a
-   special case when the ready list is empty. */
+   run queue.  It is returned by next_thread_to_run() as a
+   special case when the run queue is empty. */
 static void
 idle (void *idle_started_ UNUSED) 
 {
@@ -406,6 +1941,14 @@ idle (void *idle_started_ UNUSED)
       intr_disable ();
       thread_block ();
 
+      /* Use the spare time to zero free pages. */
+      intr_enable ();
+      palloc_zero_idle ();
+      intr_disable ();
+
+      /* Stop the periodic tick if nothing needs it soon. */
+      timer_idle_enter ();
+
       /* Re-enable interrupts and wait for the next one.
 
          The `sti' instruction disables interrupts until the
@@ -433,18 +1976,111 @@ kernel_thread (thread_func *function, void *aux)
   thread_exit ();       /* If function() returns, kill the thread. */
 }
 
-/* Returns the running thread. */
+/* Returns the running thread.  Kernel stacks are not in the same
+   page as `struct thread', so the stack pointer cannot locate
+   it; instead schedule() records in current_thread which thread
+   it is switching to. */
 struct thread *
 running_thread (void) 
 {
-  uint32_t *esp;
+  return current_thread;
+}
 
-  /* Copy the CPU's stack pointer into `esp', and then round that
-     down to the start of a page.  Because `struct thread' is
-     always at the beginning of a page and the stack pointer is
-     somewhere in the middle, this locates the curent thread. */
-  asm ("mov %%esp, %0" : "=g" (esp));
-  return pg_round_down (esp);
+/* Returns true if ADDR lies in the guard page below T's kernel
+   stack, meaning that the stack has overflowed. */
+bool
+thread_stack_guard (const struct thread *t, const void *addr)
+{
+  const uint8_t *a = addr;
+
+  return t->kstack != NULL && a < t->kstack && a >= t->kstack - PGSIZE;
+}
+
+/* Marks kernel page PAGE as present or not present in the
+   kernel's page tables, which every process's page directory
+   shares, and flushes its stale TLB entry. */
+static void
+set_page_present (void *page, bool present)
+{
+  uint32_t *pt = pde_get_pt (init_page_dir[pd_no (page)]);
+  uint32_t *pte = &pt[pt_no (page)];
+
+  if (present)
+    *pte |= PTE_P;
+  else
+    *pte &= ~PTE_P;
+  asm volatile ("invlpg (%0)" : : "r" (page) : "memory");
+}
+
+/* Allocates a zeroed kernel stack of thread_kstack_pages pages,
+   with an unmapped guard page below it, and returns its lowest
+   address.  Returns a null pointer if memory is short. */
+static uint8_t *
+kstack_alloc (void)
+{
+  uint8_t *guard = palloc_get_multiple (PAL_ZERO, thread_kstack_pages + 1);
+
+  if (guard == NULL)
+    return NULL;
+  set_page_present (guard, false);
+  return guard + PGSIZE;
+}
+
+/* Counts a new thread against thread_cnt.  Returns false, and
+   counts nothing, if the stride policy's heap could not hold
+   another ready thread. */
+static bool
+thread_cnt_reserve (void)
+{
+  enum intr_level old_level = spinlock_acquire (&all_lock);
+  bool ok = sched_policy != &stride_policy || thread_cnt <= STRIDE_HEAP_MAX;
+
+  if (ok)
+    thread_cnt++;
+  spinlock_release (&all_lock, old_level);
+  return ok;
+}
+
+/* Undoes thread_cnt_reserve() for a thread that could not be
+   created. */
+static void
+thread_cnt_release (void)
+{
+  enum intr_level old_level = spinlock_acquire (&all_lock);
+  thread_cnt--;
+  spinlock_release (&all_lock, old_level);
+}
+
+/* Frees T's kernel stack, if it has one of its own. */
+static void
+kstack_free (struct thread *t)
+{
+  uint8_t *guard;
+
+  if (t->kstack == NULL)
+    return;
+  guard = t->kstack - PGSIZE;
+  set_page_present (guard, true);
+  palloc_free_multiple (guard, (t->kstack_top - t->kstack) / PGSIZE + 1);
+  t->kstack = NULL;
+}
+
+/* Returns the number of bytes of T's kernel stack that have ever
+   been used.  The stack started out zeroed, so the lowest
+   nonzero word marks the deepest point reached.  (A zero written
+   at the very bottom would be missed, so the answer may be a few
+   words short.) */
+static size_t
+kstack_usage (const struct thread *t)
+{
+  const uint32_t *p;
+
+  if (t->kstack == NULL)
+    return 0;
+  for (p = (const uint32_t *) t->kstack;
+       p < (const uint32_t *) t->kstack_top && *p == 0; p++)
+    continue;
+  return t->kstack_top - (const uint8_t *) p;
 }
 
 /* Returns true if T appears to point to a valid thread. */
@@ -468,33 +2104,159 @@ init_thread (struct thread *t, const char *name, int priority)
   memset (t, 0, sizeof *t);
   t->status = THREAD_BLOCKED;
   strlcpy (t->name, name, sizeof t->name);
-  t->stack = (uint8_t *) t + PGSIZE;
-  t->priority = priority;
+  t->stack = t->kstack_top = (uint8_t *) t + PGSIZE;
+  t->priority = t->base_priority = priority;
   t->magic = THREAD_MAGIC;
   list_init (&t->child_meta_list);
+  list_init (&t->donors);
+  t->acct_stamp = rdtsc ();
+  t->tickets = TICKETS_DEFAULT;
 
+  /* A new thread joins its creator's group.  The initial thread
+     starts in group 0. */
   old_level = intr_disable ();
-  list_push_back (&all_list, &t->allelem);
+  t->group = t != running_thread () ? running_thread ()->group : &groups[0];
+  t->group->members++;
   intr_set_level (old_level);
+
+  /* Under the multi-level feedback queue scheduler, a new thread
+     inherits its parent's nice and recent_cpu, and its priority
+     is computed from those rather than taken from PRIORITY.  The
+     initial thread starts from zero. */
+  if (thread_mlfqs)
+    {
+      struct thread *parent = running_thread ();
+
+      if (t != parent)
+        {
+          old_level = intr_disable ();
+          mlfqs_catch_up (parent);
+          t->nice = parent->nice;
+          t->recent_cpu = parent->recent_cpu;
+          intr_set_level (old_level);
+        }
+      t->cpu_epoch = decay_epoch;
+      t->priority = mlfqs_priority (t);
+    }
+
+  old_level = spinlock_acquire (&all_lock);
+  list_push_back (&all_list, &t->allelem);
+  spinlock_release (&all_lock, old_level);
 }
 
-/* Initializes the process_metadata structure */
+/* Initializes the process_metadata structure, adds it to the
+   current thread's children and to the tid table.  Returns a
+   null pointer if memory is short. */
 struct child_metadata *
 init_child_metadata (tid_t child_tid)
 {
   struct child_metadata *metadata = 
 		calloc (1, sizeof (struct child_metadata));
+  struct child_metadata **bucket = &tid_table[child_tid % TID_BUCKETS];
+  enum intr_level old_level;
+
+  if (metadata == NULL)
+    return NULL;
   metadata->tid = child_tid;
+  metadata->parent_tid = thread_tid ();
+  metadata->thread = NULL;
   metadata->load_success = false;
   metadata->exec_file = NULL;
   sema_init (&metadata->completed, 0);
   sema_init (&metadata->child_load, 0);
   metadata->exit_status = 0;
-  struct list children = thread_current ()->child_meta_list;
-  list_push_front (&children, &metadata->infoelem);
+  list_push_front (&thread_current ()->child_meta_list, &metadata->infoelem);
+
+  old_level = spinlock_acquire (&tid_table_lock);
+  metadata->hash_next = *bucket;
+  *bucket = metadata;
+  spinlock_release (&tid_table_lock, old_level);
   return metadata;
 }
 
+/* Returns the metadata of the process with the given TID, or a
+   null pointer if there is none.  The metadata may be freed at
+   any time by its parent, so unless the caller is the parent it
+   must keep interrupts off while it uses the result. */
+struct child_metadata *
+thread_find_metadata (tid_t tid)
+{
+  struct child_metadata *md;
+  enum intr_level old_level;
+
+  old_level = spinlock_acquire (&tid_table_lock);
+  for (md = tid_table[tid % TID_BUCKETS]; md != NULL; md = md->hash_next)
+    if (md->tid == tid)
+      break;
+  spinlock_release (&tid_table_lock, old_level);
+  return md;
+}
+
+/* Removes MD from the tid table and frees it.  The caller must
+   already have removed it from its parent's child list, if
+   any. */
+void
+thread_free_metadata (struct child_metadata *md)
+{
+  struct child_metadata **p;
+  enum intr_level old_level;
+
+  old_level = spinlock_acquire (&tid_table_lock);
+  for (p = &tid_table[md->tid % TID_BUCKETS]; *p != md; p = &(*p)->hash_next)
+    ASSERT (*p != NULL);
+  *p = md->hash_next;
+  spinlock_release (&tid_table_lock, old_level);
+  free (md);
+}
+
+/* Gives up T's claim on its children's metadata as T exits.
+   Children that have already exited are freed, since no one can
+   wait for them any more; the others will free their own
+   metadata when they exit. */
+static void
+release_children (struct thread *t)
+{
+  while (!list_empty (&t->child_meta_list))
+    {
+      struct child_metadata *md =
+        list_entry (list_pop_front (&t->child_meta_list),
+                    struct child_metadata, infoelem);
+      enum intr_level old_level;
+      bool exited;
+
+      old_level = intr_disable ();
+      exited = md->thread == NULL;
+      md->parent_tid = TID_ERROR;
+      intr_set_level (old_level);
+      if (exited)
+        thread_free_metadata (md);
+    }
+}
+
+/* Marks metadata MD, if not null, as belonging to an exited
+   thread or process and wakes up a parent waiting in
+   process_wait(), or frees the metadata if the parent has
+   already exited.  Either way, the caller must not refer to MD
+   afterward. */
+void
+thread_release_metadata (struct child_metadata *md)
+{
+  enum intr_level old_level;
+  bool orphan;
+
+  if (md == NULL)
+    return;
+  old_level = intr_disable ();
+  md->thread = NULL;
+  orphan = md->parent_tid == TID_ERROR;
+  intr_set_level (old_level);
+
+  if (orphan)
+    thread_free_metadata (md);
+  else
+    sema_up (&md->completed);
+}
+
 /* Allocates a SIZE-byte frame at the top of thread T's stack and
    returns a pointer to the frame's base. */
 static void *
@@ -508,22 +2270,304 @@ alloc_frame (struct thread *t, size_t size)
   return t->stack;
 }
 
+/* Returns true if T is the idle thread. */
+static bool
+is_idle (const struct thread *t)
+{
+  return t == idle_thread;
+}
+
+/* Adds T to RQ, whose lock must be held: to the EDF threads in
+   deadline order if T is in the EDF class, otherwise wherever the
+   scheduling policy wants it. */
+static void
+rq_push (struct runqueue *rq, struct thread *t)
+{
+  ASSERT (spinlock_held (&rq->lock));
+
+  if (t->edf)
+    list_insert_ordered (&rq->edf, &t->elem, edf_earlier, NULL);
+  else
+    sched_policy->push (rq, t);
+  rq->cnt++;
+}
+
+/* Removes ready thread T from RQ, whose lock must be held. */
+static void
+rq_remove (struct runqueue *rq, struct thread *t)
+{
+  ASSERT (spinlock_held (&rq->lock));
+  ASSERT (t->status == THREAD_READY);
+
+  if (t->edf)
+    list_remove (&t->elem);
+  else
+    sched_policy->remove (rq, t);
+  rq->cnt--;
+}
+
+/* Removes and returns the EDF thread in RQ with the earliest
+   deadline, if any, otherwise the thread the scheduling policy
+   picks.  RQ's lock must be held and RQ must not be empty. */
+static struct thread *
+rq_pop (struct runqueue *rq)
+{
+  ASSERT (spinlock_held (&rq->lock));
+  ASSERT (rq->cnt > 0);
+
+  rq->cnt--;
+  if (!list_empty (&rq->edf))
+    return list_entry (list_pop_front (&rq->edf), struct thread, elem);
+  else
+    return sched_policy->pop (rq);
+}
+
+/* Adds T to the run queue. */
+static void
+ready_queue_push (struct thread *t)
+{
+  enum intr_level old_level = spinlock_acquire (&ready_rq.lock);
+
+  rq_push (&ready_rq, t);
+  spinlock_release (&ready_rq.lock, old_level);
+}
+
+/* Priority policy: run the highest-priority ready thread, round
+   robin within a priority.  Also used by the multi-level
+   feedback queue scheduler, which only differs in how it sets
+   priorities. */
+
+/* Adds T to the tail of the run queue for its priority. */
+static void
+prio_push (struct runqueue *rq, struct thread *t)
+{
+  list_push_back (&rq->queues[t->priority], &t->elem);
+  rq->bitmap |= (uint64_t) 1 << t->priority;
+}
+
+/* Removes T from the run queue for its priority. */
+static void
+prio_remove (struct runqueue *rq, struct thread *t)
+{
+  list_remove (&t->elem);
+  if (list_empty (&rq->queues[t->priority]))
+    rq->bitmap &= ~((uint64_t) 1 << t->priority);
+}
+
+/* Returns the highest priority among the threads in RQ's
+   priority queues, or -1 if they are empty. */
+static int
+ready_queue_highest (const struct runqueue *rq)
+{
+  uint32_t hi = rq->bitmap >> 32;
+  uint32_t lo = rq->bitmap;
+
+  if (hi != 0)
+    return 63 - __builtin_clz (hi);
+  else if (lo != 0)
+    return 31 - __builtin_clz (lo);
+  else
+    return -1;
+}
+
+/* Removes and returns the thread at the head of the
+   highest-priority non-empty run queue. */
+static struct thread *
+prio_pop (struct runqueue *rq)
+{
+  int priority = ready_queue_highest (rq);
+  struct list *queue;
+  struct thread *t;
+
+  ASSERT (priority >= PRI_MIN);
+
+  queue = &rq->queues[priority];
+  t = list_entry (list_pop_front (queue), struct thread, elem);
+  if (list_empty (queue))
+    rq->bitmap &= ~((uint64_t) 1 << priority);
+  return t;
+}
+
+/* Returns true if a thread in RQ has a higher priority than
+   CUR. */
+static bool
+prio_preempts (struct runqueue *rq, const struct thread *cur)
+{
+  return ready_queue_highest (rq) > cur->priority;
+}
+
+/* Stride policy: proportional share.  Each thread advances its
+   pass by STRIDE1 / tickets for every tick it runs, and the
+   ready thread with the lowest pass runs next, so over time each
+   thread gets CPU time in proportion to its tickets, with an
+   error bounded by one time slice.  Ready threads are kept in a
+   binary min-heap on pass, so selection is O(log n).  A thread
+   that was blocked does not bank credit: its pass is brought up
+   to the run queue's stride_vtime, the pass of the thread most
+   recently picked from it, when it becomes ready again. */
+
+/* Swaps slots I and J of RQ's heap. */
+static void
+stride_swap (struct runqueue *rq, size_t i, size_t j)
+{
+  struct thread **heap = rq->stride_heap;
+  struct thread *t = heap[i];
+
+  heap[i] = heap[j];
+  heap[j] = t;
+  heap[i]->heap_idx = i;
+  heap[j]->heap_idx = j;
+}
+
+/* Moves the thread in slot I of RQ's heap up or down until the
+   heap is ordered again. */
+static void
+stride_fix (struct runqueue *rq, size_t i)
+{
+  struct thread **heap = rq->stride_heap;
+
+  while (i > 0 && heap[i]->pass < heap[(i - 1) / 2]->pass)
+    {
+      stride_swap (rq, i, (i - 1) / 2);
+      i = (i - 1) / 2;
+    }
+  for (;;)
+    {
+      size_t min = i, left = 2 * i + 1, right = 2 * i + 2;
+
+      if (left < rq->stride_cnt && heap[left]->pass < heap[min]->pass)
+        min = left;
+      if (right < rq->stride_cnt && heap[right]->pass < heap[min]->pass)
+        min = right;
+      if (min == i)
+        break;
+      stride_swap (rq, i, min);
+      i = min;
+    }
+}
+
+/* Adds T to RQ's heap. */
+static void
+stride_push (struct runqueue *rq, struct thread *t)
+{
+  ASSERT (rq->stride_cnt < STRIDE_HEAP_MAX);
+
+  if (t->pass < rq->stride_vtime)
+    t->pass = rq->stride_vtime;
+  t->heap_idx = rq->stride_cnt;
+  rq->stride_heap[rq->stride_cnt++] = t;
+  stride_fix (rq, t->heap_idx);
+}
+
+/* Removes T from RQ's heap. */
+static void
+stride_remove (struct runqueue *rq, struct thread *t)
+{
+  size_t i = t->heap_idx;
+
+  ASSERT (i < rq->stride_cnt && rq->stride_heap[i] == t);
+
+  rq->stride_cnt--;
+  if (i != rq->stride_cnt)
+    {
+      rq->stride_heap[i] = rq->stride_heap[rq->stride_cnt];
+      rq->stride_heap[i]->heap_idx = i;
+      stride_fix (rq, i);
+    }
+}
+
+/* Removes and returns the thread in RQ with the lowest pass. */
+static struct thread *
+stride_pop (struct runqueue *rq)
+{
+  struct thread *t = rq->stride_heap[0];
+
+  ASSERT (rq->stride_cnt > 0);
+
+  stride_remove (rq, t);
+  rq->stride_vtime = t->pass;
+  return t;
+}
+
+/* Returns true if a thread in RQ is further behind than CUR. */
+static bool
+stride_preempts (struct runqueue *rq, const struct thread *cur)
+{
+  return rq->stride_cnt > 0 && rq->stride_heap[0]->pass < cur->pass;
+}
+
+/* Charges a tick to T. */
+static void
+stride_tick (struct thread *t)
+{
+  t->pass += STRIDE1 / t->tickets;
+}
+
+/* Sets T's priority to PRIORITY.  If T is in the run queue,
+   moves it to the queue for its new priority; if it is blocked
+   on a semaphore, lock or condition variable, moves it to its
+   new place among the waiters. */
+static void
+set_effective_priority (struct thread *t, int priority)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (t->status == THREAD_READY && !is_idle (t))
+    {
+      struct runqueue *rq = &ready_rq;
+      enum intr_level old_level = spinlock_acquire (&rq->lock);
+
+      rq_remove (rq, t);
+      t->priority = priority;
+      rq_push (rq, t);
+      spinlock_release (&rq->lock, old_level);
+    }
+  else
+    {
+      t->priority = priority;
+      if (t->status == THREAD_BLOCKED)
+        synch_requeue (t);
+    }
+}
+
 /* Chooses and returns the next thread to be scheduled.  Should
    return a thread from the run queue, unless the run queue is
    empty.  (If the running thread can continue running, then it
-   will be in the run queue.)  If the run queue is empty, return
-   idle_thread. */
+   will be in the run queue.)  If the run queue is empty, returns
+   idle_thread.
+
+   Each pop takes constant time under the priority and MLFQS
+   policies and O(log n) in the number of ready threads under the
+   stride policy.  A thread whose group is out of quota is parked
+   and the queue popped again, so one call may pop up to once per
+   ready thread. */
 static struct thread *
 next_thread_to_run (void) 
 {
-  if (list_empty (&ready_list))
-    return idle_thread;
-  else
-    return list_entry (list_pop_front (&ready_list), struct thread, elem);
+  struct runqueue *rq = &ready_rq;
+
+  for (;;)
+    {
+      enum intr_level old_level;
+      struct thread *t;
+
+      old_level = spinlock_acquire (&rq->lock);
+      t = rq->cnt > 0 ? rq_pop (rq) : NULL;
+      spinlock_release (&rq->lock, old_level);
+      if (t == NULL)
+        return idle_thread;
+
+      /* Threads whose group ran out of quota while they were
+         ready are parked when they come up. */
+      if (!group_throttled (t))
+        return t;
+      group_park (t);
+    }
 }
 
 /* Completes a thread switch by activating the new thread's page
-   tables, and, if the previous thread is dying, destroying it.
+   tables, and, if the previous thread is dying, having it
+   destroyed.
 
    At this function's invocation, we just switched from thread
    PREV, the new thread is already running, and interrupts are
@@ -545,27 +2589,93 @@ thread_schedule_tail (struct thread *prev)
   
   ASSERT (intr_get_level () == INTR_OFF);
 
+  /* Account for the switch.  A thread that blocked or exited gave
+     up the CPU voluntarily; one that is still ready to run was
+     preempted or yielded. */
+  if (prev != NULL)
+    {
+      uint64_t now = rdtsc ();
+
+      charge_running (prev, now);
+      if (prev->status == THREAD_READY)
+        prev->involuntary_switches++;
+      else
+        prev->voluntary_switches++;
+      cur->wait_cycles += now - cur->acct_stamp;
+      if (cur->woken)
+        {
+          uint64_t latency = now - cur->acct_stamp;
+
+          wakeup_cnt++;
+          wakeup_cycles += latency;
+          if (latency > wakeup_max)
+            wakeup_max = latency;
+          cur->woken = false;
+        }
+      cur->acct_stamp = cur->last_run = now;
+      switch_cnt++;
+      trace_event (TRACE_SWITCH, prev, cur);
+    }
+
   /* Mark us as running. */
   cur->status = THREAD_RUNNING;
 
   /* Start new time slice. */
   thread_ticks = 0;
+  irqtrace_touch ();
 
 #ifdef USERPROG
   /* Activate the new address space. */
   process_activate ();
 #endif
 
-  /* If the thread we switched from is dying, destroy its struct
-     thread.  This must happen late so that thread_exit() doesn't
-     pull out the rug under itself.  (We don't free
-     initial_thread because its memory was not obtained via
-     palloc().) */
+  /* If the thread we switched from is dying, hand its struct
+     thread to the reaper to free.  This must happen late so that
+     thread_exit() doesn't pull out the rug under itself.  (We
+     don't free initial_thread because its memory was not
+     obtained via palloc().) */
   if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread) 
     {
       ASSERT (prev != cur);
-      palloc_free_page (prev);
+      if (reaper_running)
+        {
+          work_init (&prev->reap_work, reap_work, prev);
+          work_queue (&reaper_wq, &prev->reap_work);
+        }
+      else
+        reap_thread (prev);
+    }
+}
+
+/* Work function for the reaper: frees dead thread T_ with
+   reap_thread(). */
+static void
+reap_work (void *t_)
+{
+  lock_acquire (&reap_lock);
+  reap_thread (t_);
+  lock_release (&reap_lock);
+}
+
+/* Records how deep dead thread T_'s kernel stack went, then
+   frees the stack and T_ itself, including the work item
+   embedded in it. */
+static void
+reap_thread (void *t_)
+{
+  struct thread *t = t_;
+  size_t used;
+
+  ASSERT (t->status == THREAD_DYING);
+
+  used = kstack_usage (t);
+  if (used > kstack_peak)
+    {
+      kstack_peak = used;
+      strlcpy (kstack_peak_name, t->name, sizeof kstack_peak_name);
     }
+  kstack_free (t);
+  palloc_free_page (t);
 }
 
 /* Schedules a new process.  At entry, interrupts must be off and
@@ -586,21 +2696,33 @@ schedule (void)
   ASSERT (cur->status != THREAD_RUNNING);
   ASSERT (is_thread (next));
 
+  if (is_idle (cur))
+    timer_idle_exit ();
   if (cur != next)
-    prev = switch_threads (cur, next);
+    {
+      current_thread = next;
+      prev = switch_threads (cur, next);
+    }
   thread_schedule_tail (prev);
 }
 
-/* Returns a tid to use for a new thread. */
+/* Returns a tid to use for a new thread.  Tids count up from 1
+   and wrap around after INT_MAX, skipping those still in the tid
+   table. */
 static tid_t
 allocate_tid (void) 
 {
-  static tid_t next_tid = 1;
+  static uint32_t next_tid = 1;
   tid_t tid;
 
-  lock_acquire (&tid_lock);
-  tid = next_tid++;
-  lock_release (&tid_lock);
+  do
+    {
+      uint32_t n = 1;
+      asm volatile ("lock xaddl %0, %1"
+                    : "+r" (n), "+m" (next_tid) : : "memory");
+      tid = n & INT_MAX;
+    }
+  while (tid == 0 || thread_find_metadata (tid) != NULL);
 
   return tid;
 }
@@ -4,8 +4,11 @@
 #include <debug.h>
 #include <list.h>
 #include <stdint.h>
+#include "devices/timer.h"
 #include "filesys/file.h"
+#include "threads/fixed-point.h"
 #include "threads/synch.h"
+#include "threads/workqueue.h"
 
 /* States in a thread's life cycle. */
 enum thread_status
@@ -26,17 +29,33 @@ typedef int tid_t;
 #define PRI_DEFAULT 31                  /* Default priority. */
 #define PRI_MAX 63                      /* Highest priority. */
 
+/* Thread nice values, for the multi-level feedback queue
+   scheduler. */
+#define NICE_MIN -20                    /* Nicest to other threads. */
+#define NICE_DEFAULT 0                  /* Default nice value. */
+#define NICE_MAX 20                     /* Least nice to other threads. */
+
+/* Number of process groups for CPU bandwidth control. */
+#define GROUP_CNT 16
+
+/* Thread tickets, for the stride scheduler. */
+#define TICKETS_DEFAULT 100             /* Default share. */
+#define TICKETS_MAX 10000               /* Largest share. */
+
+/* Kernel stack size, in pages, not counting the guard page. */
+#define KSTACK_PAGES_DEFAULT 2          /* Default. */
+#define KSTACK_PAGES_MAX 16             /* Largest allowed. */
+
 /* Maximum file descriptors for a process */
 #define MAX_FD 128
 /* A kernel thread or user process.
 
    Each thread structure is stored in its own 4 kB page.  The
-   thread structure itself sits at the very bottom of the page
-   (at offset 0).  The rest of the page is reserved for the
-   thread's kernel stack, which grows downward from the top of
-   the page (at offset 4 kB).  Here's an illustration:
+   thread's kernel stack is allocated separately, as a run of
+   thread_kstack_pages pages with one more page below it that is
+   left unmapped, as a guard:
 
-        4 kB +---------------------------------+
+             +---------------------------------+ <- kstack_top
              |          kernel stack           |
              |                |                |
              |                |                |
@@ -44,40 +63,29 @@ typedef int tid_t;
              |         grows downward          |
              |                                 |
              |                                 |
-             |                                 |
-             |                                 |
-             |                                 |
-             |                                 |
-             |                                 |
-             |                                 |
+             +---------------------------------+ <- kstack
+             |    guard page (never mapped)    |
              +---------------------------------+
-             |              magic              |
-             |                :                |
-             |                :                |
-             |               name              |
-             |              status             |
-        0 kB +---------------------------------+
-
-   The upshot of this is twofold:
-
-      1. First, `struct thread' must not be allowed to grow too
-         big.  If it does, then there will not be enough room for
-         the kernel stack.  Our base `struct thread' is only a
-         few bytes in size.  It probably should stay well under 1
-         kB.
-
-      2. Second, kernel stacks must not be allowed to grow too
-         large.  If a stack overflows, it will corrupt the thread
-         state.  Thus, kernel functions should not allocate large
-         structures or arrays as non-static local variables.  Use
-         dynamic allocation with malloc() or palloc_get_page()
-         instead.
-
-   The first symptom of either of these problems will probably be
-   an assertion failure in thread_current(), which checks that
-   the `magic' member of the running thread's `struct thread' is
-   set to THREAD_MAGIC.  Stack overflow will normally change this
-   value, triggering the assertion. */
+
+   A stack that overflows runs into the guard page and faults at
+   once, instead of silently corrupting whatever lies below it.
+   That fault cannot be handled on the overflowed stack, so the
+   CPU turns it into a double fault, which runs as a task of its
+   own, on its own stack (see userprog/tss.c), and reports the
+   overflow.
+
+   The initial thread is the exception.  loader.S set up its
+   stack before there was a page allocator, in the same page as
+   its struct thread, with the stack growing down from the top of
+   the page toward the structure, so an overflow there is only
+   caught later, by the check of the `magic' member in
+   thread_current().
+
+   Kernel functions still should not allocate large structures
+   or arrays as non-static local variables.  Use dynamic
+   allocation with malloc() or palloc_get_page() instead.  The
+   deepest each stack has grown is kept in `kstack_max', to size
+   stacks by. */
 /* The `elem' member has a dual purpose.  It can be an element in
    the run queue (thread.c), or it can be an element in a
    semaphore wait list (synch.c).  It can be used these two ways
@@ -91,16 +99,69 @@ struct thread
     enum thread_status status;          /* Thread state. */
     char name[16];                      /* Name (for debugging purposes). */
     uint8_t *stack;                     /* Saved stack pointer. */
+    uint8_t *kstack;                    /* Bottom of kernel stack. */
+    uint8_t *kstack_top;                /* Top of kernel stack. */
+    size_t kstack_max;                  /* Deepest stack use, in bytes. */
     int priority;                       /* Priority. */
     struct list_elem allelem;           /* List element for all threads list. */
+    struct work reap_work;              /* Frees us once we have exited. */
+
+    /* Multi-level feedback queue scheduler state. */
+    int nice;                           /* Niceness. */
+    fixed_t recent_cpu;                 /* Decayed recent CPU usage. */
+    int64_t cpu_epoch;                  /* Decay steps applied to recent_cpu. */
+
+    /* CPU accounting, in time-stamp counter cycles. */
+    uint64_t user_cycles;               /* Time run in user mode. */
+    uint64_t kernel_cycles;             /* Time run in kernel mode. */
+    uint64_t wait_cycles;               /* Time spent ready to run. */
+    uint64_t last_run;                  /* When last switched in. */
+    uint64_t acct_stamp;                /* Start of interval being timed. */
+    bool in_user;                       /* Charge running time to user? */
+    unsigned voluntary_switches;        /* Times it blocked or exited. */
+    unsigned involuntary_switches;      /* Times it was preempted. */
+    bool woken;                         /* Ready since thread_unblock()? */
+    int boost;                          /* Priority boost since wakeup. */
+
+    /* CPU bandwidth control. */
+    struct thread_group *group;         /* Group charged for our CPU time. */
+
+    /* Stride scheduling. */
+    int tickets;                        /* Share of the CPU. */
+    int64_t pass;                       /* Virtual time used so far. */
+    size_t heap_idx;                    /* Position in ready heap. */
+
+    /* Earliest-deadline-first class.  Times are in timer ticks. */
+    bool edf;                           /* In the EDF class? */
+    int64_t edf_period;                 /* Time between job releases. */
+    int64_t edf_runtime;                /* Budget for each job. */
+    int64_t edf_rel_deadline;           /* Deadline, relative to release. */
+    int64_t edf_deadline;               /* Current job's absolute deadline. */
+    int64_t edf_release;                /* When the next job is released. */
+    int64_t edf_budget;                 /* Budget left for current job. */
+    bool edf_job_done;                  /* Current job completed? */
+    bool edf_waiting;                   /* Blocked until next release? */
+    unsigned edf_misses;                /* # of jobs that missed deadline. */
+    struct timer_event edf_timer;       /* Fires at each job release. */
 
     /* Shared between thread.c and synch.c. */
     struct list_elem elem;              /* List element. */
+    int base_priority;                  /* Priority before donations. */
+    struct list *wait_list;             /* Priority-ordered wait queue. */
+    struct lock *wait_lock;             /* Lock being waited for, if any. */
+    struct thread *donee;               /* Thread we donate priority to. */
+    struct list donors;                 /* Threads donating priority to us. */
+    struct list_elem donor_elem;        /* Element in donee's `donors'. */
 
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
     uint32_t *pagedir;                  /* Page directory. */
-    struct file *fd[MAX_FD];		
+    struct file **fd;                   /* File table of our process. */
+    struct process *process;            /* Our process, if a user thread. */
+    struct list_elem process_elem;      /* Element in process's `threads'. */
+    int ustack_slot;                    /* Our user stack's slot. */
+    bool killed;                        /* Must exit before user mode. */
+    struct futex_waiter *futex_waiter;  /* Futex wait in progress. */
     struct list child_meta_list;
     struct child_metadata *md;
 #endif
@@ -109,16 +170,22 @@ struct thread
     unsigned magic;                     /* Detects stack overflow. */
   };
 
-/* Metadata for a process */
+/* Metadata for a process.  Outlives the process itself until
+   its parent waits for it or exits, and stays in the tid table
+   meanwhile so that its tid is not reused. */
 struct child_metadata
 {
   tid_t tid;
+  tid_t parent_tid;             /* TID_ERROR once the parent exits. */
+  struct thread *thread;        /* The child, or NULL once it exits. */
   int exit_status;
   bool load_success;
+  bool user_thread;             /* Extra thread of its creator's process? */
   struct file *exec_file;
   struct semaphore completed;
   struct semaphore child_load;
-  struct list_elem infoelem;
+  struct list_elem infoelem;    /* Element in parent's child_meta_list. */
+  struct child_metadata *hash_next; /* Next in tid table bucket. */
 };
 
 /* If false (default), use round-robin scheduler.
@@ -126,11 +193,21 @@ struct child_metadata
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+/* Scheduler tunables. */
+extern unsigned thread_slice_min;
+extern unsigned thread_slice_max;
+extern int thread_wake_boost;
+extern unsigned thread_kstack_pages;
+
 void thread_init (void);
 void thread_start (void);
 
 void thread_tick (void);
+void thread_tick_idle (int64_t ticks);
+void thread_enter_kernel (void);
+void thread_enter_user (void);
 void thread_print_stats (void);
+void thread_switch_bench (void);
 
 typedef void thread_func (void *aux);
 tid_t thread_create (const char *name, int priority, thread_func *, void *);
@@ -141,16 +218,38 @@ void thread_unblock (struct thread *);
 struct thread *thread_current (void);
 tid_t thread_tid (void);
 const char *thread_name (void);
+bool thread_stack_guard (const struct thread *, const void *addr);
 
 void thread_exit (void) NO_RETURN;
 void thread_yield (void);
+void thread_preempt (void);
 
 /* Performs some operation on thread t, given auxiliary data AUX. */
 typedef void thread_action_func (struct thread *t, void *aux);
 void thread_foreach (thread_action_func *, void *);
 
+struct child_metadata *thread_find_metadata (tid_t);
+void thread_free_metadata (struct child_metadata *);
+void thread_release_metadata (struct child_metadata *);
+
 int thread_get_priority (void);
 void thread_set_priority (int);
+void thread_donate (struct thread *donor, struct thread *donee);
+void thread_undonate (struct thread *donor);
+void thread_refresh_priority (struct thread *);
+
+bool thread_set_policy (const char *name);
+int thread_get_tickets (void);
+void thread_set_tickets (int);
+void thread_stride_bench (void);
+
+bool thread_set_group (int group);
+bool thread_set_group_quota (int group, int64_t quota, int64_t period);
+void thread_print_groups (void);
+
+bool thread_set_deadline (int64_t period, int64_t runtime, int64_t deadline);
+void thread_yield_job (void);
+void thread_edf_bench (void);
 
 int thread_get_nice (void);
 void thread_set_nice (int);
@@ -0,0 +1,683 @@
+#include "devices/timer.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <list.h>
+#include <round.h>
+#include <stdio.h>
+#include "devices/pit.h"
+#include "threads/interrupt.h"
+#include "threads/irqtrace.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/tsc.h"
+  
+/* See [8254] for hardware details of the 8254 timer chip. */
+
+#if TIMER_FREQ < 19
+#error 8254 timer requires TIMER_FREQ >= 19
+#endif
+#if TIMER_FREQ > 1000
+#error TIMER_FREQ <= 1000 recommended
+#endif
+
+/* Number of timer ticks since OS booted. */
+static int64_t ticks;
+
+/* Number of loops per timer tick.
+   Initialized by timer_calibrate(). */
+static unsigned loops_per_tick;
+
+/* Number of time-stamp counter cycles per timer tick.
+   Initialized by timer_calibrate(). */
+static uint64_t cycles_per_tick;
+
+/* Hierarchical timer wheel.
+
+   Level 0 has one slot per tick for the next WHEEL_SLOTS ticks.
+   Each slot of level N > 0 covers WHEEL_SLOTS times as many
+   ticks as a slot of level N - 1.  An event is filed in the
+   lowest level whose range covers its expiry.  Each tick runs
+   the events in one level-0 slot; each time the level-0 index
+   wraps around, one slot of level 1 is redistributed ("cascaded")
+   into level 0, and so on up the levels.  Adding, cancelling,
+   and firing an event are all O(1), and an event is cascaded at
+   most WHEEL_LEVELS - 1 times, so the cost of a tick does not
+   depend on the number of pending events. */
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS 4
+static struct list wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+static int64_t wheel_ticks;       /* Next tick to run in the wheel. */
+static int64_t events_fired;      /* Statistics. */
+static int64_t events_cascaded;
+static uint64_t wheel_cycles;     /* Cycles spent in timer_softirq(). */
+static uint64_t wheel_cycles_max; /* Longest single timer_softirq(). */
+static int64_t wheel_runs;        /* Wheel ticks run by timer_softirq(). */
+
+/* If true, stop the periodic tick while the CPU is idle.
+   Controlled by kernel command-line option "-tickless". */
+bool timer_tickless;
+
+/* Tickless idle.  While the idle thread has the CPU halted,
+   channel 0 of the PIT is loaded with a single count that
+   expires on the tick at which the first sleeper is due, rather
+   than interrupting every tick.  A 16-bit count only spans
+   TICKLESS_MAX_TICKS ticks, so a long idle period still takes an
+   interrupt every few ticks, but no more. */
+#define PIT_CYCLES_PER_TICK ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+#define TICKLESS_MAX_TICKS (UINT16_MAX / PIT_CYCLES_PER_TICK)
+static int64_t oneshot_ticks;     /* Ticks the armed count spans, or 0. */
+static uint16_t oneshot_count;    /* PIT cycles the armed count spans. */
+static uint16_t oneshot_phase;    /* PIT cycles to the first tick. */
+static int64_t skipped_ticks;     /* Timer interrupts avoided. */
+
+static intr_handler_func timer_interrupt;
+static bool too_many_loops (unsigned loops);
+static void busy_wait (int64_t loops);
+static void real_time_sleep (int64_t num, int32_t denom);
+static void real_time_delay (int64_t num, int32_t denom);
+static softirq_func timer_softirq;
+static void wheel_insert (struct timer_event *);
+static void wheel_run (bool preemptible);
+static void bench_sleeper (void *ticks);
+static void bench_measure (int sleepers);
+
+/* Sets up the timer to interrupt TIMER_FREQ times per second,
+   and registers the corresponding interrupt. */
+void
+timer_init (void) 
+{
+  int level, slot;
+
+  for (level = 0; level < WHEEL_LEVELS; level++)
+    for (slot = 0; slot < WHEEL_SLOTS; slot++)
+      list_init (&wheel[level][slot]);
+  pit_configure_channel (0, 2, TIMER_FREQ);
+  intr_register_ext (0x20, timer_interrupt, "8254 Timer");
+  softirq_register (SOFTIRQ_TIMER, timer_softirq, "timer");
+}
+
+/* Calibrates loops_per_tick, used to implement brief delays. */
+void
+timer_calibrate (void) 
+{
+  unsigned high_bit, test_bit;
+  uint64_t start_cycles;
+  int64_t start;
+
+  ASSERT (intr_get_level () == INTR_ON);
+  printf ("Calibrating timer...  ");
+
+  /* Approximate loops_per_tick as the largest power-of-two
+     still less than one timer tick. */
+  loops_per_tick = 1u << 10;
+  while (!too_many_loops (loops_per_tick << 1)) 
+    {
+      loops_per_tick <<= 1;
+      ASSERT (loops_per_tick != 0);
+    }
+
+  /* Refine the next 8 bits of loops_per_tick. */
+  high_bit = loops_per_tick;
+  for (test_bit = high_bit >> 1; test_bit != high_bit >> 10; test_bit >>= 1)
+    if (!too_many_loops (high_bit | test_bit))
+      loops_per_tick |= test_bit;
+
+  printf ("%'"PRIu64" loops/s, ", (uint64_t) loops_per_tick * TIMER_FREQ);
+
+  /* Count time-stamp counter cycles across one tick. */
+  start = ticks;
+  while (ticks == start)
+    barrier ();
+  start_cycles = rdtsc ();
+  start = ticks;
+  while (ticks == start)
+    barrier ();
+  cycles_per_tick = rdtsc () - start_cycles;
+
+  printf ("%'"PRIu64" cycles/s.\n", cycles_per_tick * TIMER_FREQ);
+}
+
+/* Returns the number of timer ticks since the OS booted. */
+int64_t
+timer_ticks (void) 
+{
+  enum intr_level old_level = intr_disable ();
+  int64_t t = ticks;
+  intr_set_level (old_level);
+  return t;
+}
+
+/* Returns the number of timer ticks elapsed since THEN, which
+   should be a value once returned by timer_ticks(). */
+int64_t
+timer_elapsed (int64_t then) 
+{
+  return timer_ticks () - then;
+}
+
+/* Converts CYCLES, a difference between two readings of the
+   time-stamp counter, to microseconds.  Returns 0 before
+   timer_calibrate() has run. */
+uint64_t
+timer_cycles_to_us (uint64_t cycles)
+{
+  if (cycles_per_tick == 0)
+    return 0;
+  return cycles * (1000 * 1000 / TIMER_FREQ) / cycles_per_tick;
+}
+
+/* Converts US microseconds to time-stamp counter cycles, the
+   inverse of timer_cycles_to_us().  Returns 0 before
+   timer_calibrate() has run. */
+uint64_t
+timer_us_to_cycles (uint64_t us)
+{
+  return us * cycles_per_tick / (1000 * 1000 / TIMER_FREQ);
+}
+
+/* Initializes timer event EVENT to call FUNC with AUX. */
+void
+timer_event_init (struct timer_event *event, timer_func *func, void *aux)
+{
+  ASSERT (event != NULL);
+  ASSERT (func != NULL);
+
+  event->func = func;
+  event->aux = aux;
+  event->pending = false;
+}
+
+/* Arranges for EVENT, which must not be pending, to fire once
+   timer_ticks() reaches EXPIRES.  If EXPIRES has already passed,
+   EVENT fires on the next tick.
+
+   This function may be called from an interrupt handler. */
+void
+timer_event_add (struct timer_event *event, int64_t expires)
+{
+  enum intr_level old_level;
+
+  ASSERT (event != NULL);
+  ASSERT (!event->pending);
+
+  old_level = intr_disable ();
+  event->expires = expires;
+  event->pending = true;
+  wheel_insert (event);
+  intr_set_level (old_level);
+}
+
+/* Removes EVENT from the timer wheel if it has not fired yet.
+   Returns true if EVENT was cancelled, false if it had already
+   fired or was never added.
+
+   This function may be called from an interrupt handler. */
+bool
+timer_event_cancel (struct timer_event *event)
+{
+  enum intr_level old_level;
+  bool cancelled;
+
+  ASSERT (event != NULL);
+
+  old_level = intr_disable ();
+  cancelled = event->pending;
+  if (cancelled)
+    {
+      list_remove (&event->elem);
+      event->pending = false;
+    }
+  intr_set_level (old_level);
+  return cancelled;
+}
+
+/* Timer event function that wakes up thread T. */
+static void
+wake_thread (void *t)
+{
+  thread_unblock (t);
+}
+
+/* Sleeps for approximately TICKS timer ticks.  Interrupts must
+   be turned on.  The thread is blocked, not busy-waiting, until
+   the timer interrupt wakes it up. */
+void
+timer_sleep (int64_t ticks) 
+{
+  struct timer_event event;
+  enum intr_level old_level;
+
+  ASSERT (intr_get_level () == INTR_ON);
+  if (ticks <= 0)
+    return;
+
+  old_level = intr_disable ();
+  timer_event_init (&event, wake_thread, thread_current ());
+  timer_event_add (&event, ticks + timer_ticks ());
+  thread_block ();
+  intr_set_level (old_level);
+}
+
+/* Sleeps for approximately MS milliseconds.  Interrupts must be
+   turned on. */
+void
+timer_msleep (int64_t ms) 
+{
+  real_time_sleep (ms, 1000);
+}
+
+/* Sleeps for approximately US microseconds.  Interrupts must be
+   turned on. */
+void
+timer_usleep (int64_t us) 
+{
+  real_time_sleep (us, 1000 * 1000);
+}
+
+/* Sleeps for approximately NS nanoseconds.  Interrupts must be
+   turned on. */
+void
+timer_nsleep (int64_t ns) 
+{
+  real_time_sleep (ns, 1000 * 1000 * 1000);
+}
+
+/* Busy-waits for approximately MS milliseconds.  Interrupts need
+   not be turned on.
+
+   Busy waiting wastes CPU cycles, and busy waiting with
+   interrupts off for the interval between timer ticks or longer
+   will cause timer ticks to be lost.  Thus, use timer_msleep()
+   instead if interrupts are enabled. */
+void
+timer_mdelay (int64_t ms) 
+{
+  real_time_delay (ms, 1000);
+}
+
+/* Sleeps for approximately US microseconds.  Interrupts need not
+   be turned on.
+
+   Busy waiting wastes CPU cycles, and busy waiting with
+   interrupts off for the interval between timer ticks or longer
+   will cause timer ticks to be lost.  Thus, use timer_usleep()
+   instead if interrupts are enabled. */
+void
+timer_udelay (int64_t us) 
+{
+  real_time_delay (us, 1000 * 1000);
+}
+
+/* Sleeps execution for approximately NS nanoseconds.  Interrupts
+   need not be turned on.
+
+   Busy waiting wastes CPU cycles, and busy waiting with
+   interrupts off for the interval between timer ticks or longer
+   will cause timer ticks to be lost.  Thus, use timer_nsleep()
+   instead if interrupts are enabled.*/
+void
+timer_ndelay (int64_t ns) 
+{
+  real_time_delay (ns, 1000 * 1000 * 1000);
+}
+
+/* Called by the idle thread, with interrupts off, just before it
+   halts the CPU.  If tickless idle is enabled and no sleeper is
+   due on the next tick, replaces the periodic tick by a single
+   count that expires when the first sleeper is due (or as late
+   as the PIT allows). */
+void
+timer_idle_enter (void)
+{
+  int64_t delta;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!timer_tickless || oneshot_ticks != 0)
+    return;
+
+  /* Find the first tick with work to do: a level-0 slot with
+     events in it, or a cascade that might move events due soon
+     into level 0. */
+  for (delta = 1; delta < TICKLESS_MAX_TICKS; delta++)
+    {
+      int64_t tick = ticks + delta;
+      if ((tick & WHEEL_MASK) == 0 || !list_empty (&wheel[0][tick & WHEEL_MASK]))
+        break;
+    }
+  if (delta < 2)
+    return;
+
+  /* Keep the tick phase: the count runs out exactly where the
+     DELTA'th periodic tick would have fallen. */
+  oneshot_phase = pit_read_count (0);
+  oneshot_count = oneshot_phase + (delta - 1) * PIT_CYCLES_PER_TICK;
+  oneshot_ticks = delta;
+  pit_start_oneshot (0, oneshot_count);
+}
+
+/* Called with interrupts off when the idle thread gives up the
+   CPU.  If an interrupt other than the timer's woke the CPU
+   while the periodic tick was stopped, accounts for the ticks
+   that elapsed so far and restarts the periodic tick. */
+void
+timer_idle_exit (void)
+{
+  uint16_t remaining;
+  int64_t elapsed;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (oneshot_ticks == 0)
+    return;
+
+  /* If the count has already run out, the timer interrupt is
+     pending and will do the accounting as soon as interrupts
+     are turned back on. */
+  remaining = pit_read_count (0);
+  if (remaining > oneshot_count)
+    return;
+
+  elapsed = oneshot_count - remaining;
+  if (elapsed < oneshot_phase)
+    elapsed = 0;
+  else
+    elapsed = 1 + (elapsed - oneshot_phase) / PIT_CYCLES_PER_TICK;
+  if (elapsed >= oneshot_ticks)
+    elapsed = oneshot_ticks - 1;
+
+  oneshot_ticks = 0;
+  pit_configure_channel (0, 2, TIMER_FREQ);
+  if (elapsed > 0)
+    {
+      ticks += elapsed;
+      thread_tick_idle (elapsed);
+      skipped_ticks += elapsed;
+      wheel_run (false);
+    }
+}
+
+/* Prints timer statistics. */
+void
+timer_print_stats (void) 
+{
+  printf ("Timer: %"PRId64" ticks, %"PRId64" skipped while idle, "
+          "%"PRId64" events fired, %"PRId64" cascaded\n",
+          timer_ticks (), skipped_ticks, events_fired, events_cascaded);
+}
+
+/* Sleeper benchmark.  timer_bench() measures the cost of the
+   timer softirq per tick over BENCH_TICKS ticks, first with no
+   sleepers of its own and then with BENCH_SLEEPERS threads
+   asleep.  The sleepers' wakeups are spread over several wheel
+   levels and all fall after the second measurement, so the
+   second measurement includes cascades but no wakeups.  Stops
+   creating sleepers early if memory runs out. */
+#define BENCH_SLEEPERS 1000
+#define BENCH_TICKS 200
+static struct semaphore bench_done;
+
+/* Runs the sleeper benchmark and prints its results. */
+void
+timer_bench (void)
+{
+  int sleepers;
+
+  bench_measure (0);
+  sema_init (&bench_done, 0);
+  for (sleepers = 0; sleepers < BENCH_SLEEPERS; sleepers++)
+    {
+      int sleep_ticks = 2 * BENCH_TICKS + sleepers * 37 % 500;
+
+      if (thread_create ("sleeper", PRI_DEFAULT, bench_sleeper,
+                         (void *) sleep_ticks) == TID_ERROR)
+        break;
+    }
+  bench_measure (sleepers);
+  while (sleepers-- > 0)
+    sema_down (&bench_done);
+}
+
+/* A sleeper thread for timer_bench(). */
+static void
+bench_sleeper (void *ticks)
+{
+  timer_sleep ((int) ticks);
+  sema_up (&bench_done);
+}
+
+/* Sleeps for BENCH_TICKS ticks, then prints the cost of the
+   timer softirq per tick over that time, labelled with the
+   number of SLEEPERS. */
+static void
+bench_measure (int sleepers)
+{
+  enum intr_level old_level;
+  uint64_t cycles, cycles_max;
+  int64_t runs;
+
+  old_level = intr_disable ();
+  wheel_cycles = wheel_cycles_max = 0;
+  wheel_runs = 0;
+  intr_set_level (old_level);
+
+  timer_sleep (BENCH_TICKS);
+
+  old_level = intr_disable ();
+  cycles = wheel_cycles;
+  cycles_max = wheel_cycles_max;
+  runs = wheel_runs;
+  intr_set_level (old_level);
+
+  printf ("%4d sleepers: %"PRId64" ticks, %"PRIu64" cycles/tick average, "
+          "%"PRIu64" max\n", sleepers, runs,
+          runs != 0 ? cycles / runs : 0, cycles_max);
+}
+
+/* Timer interrupt handler.  Only keeps time and charges the
+   tick; the events that are due run afterward in
+   timer_softirq(). */
+static void
+timer_interrupt (struct intr_frame *args)
+{
+  irqtrace_tick (args);
+
+  if (oneshot_ticks != 0)
+    {
+      /* The count loaded by timer_idle_enter() ran out.  The CPU
+         sat idle for all the ticks it spanned. */
+      int64_t elapsed = oneshot_ticks;
+
+      oneshot_ticks = 0;
+      pit_configure_channel (0, 2, TIMER_FREQ);
+      ticks += elapsed;
+      thread_tick_idle (elapsed);
+      skipped_ticks += elapsed - 1;
+    }
+  else
+    {
+      ticks++;
+      thread_tick ();
+    }
+  softirq_raise (SOFTIRQ_TIMER);
+}
+
+/* Timer softirq: fires the timer events that are due. */
+static void
+timer_softirq (void)
+{
+  enum intr_level old_level = intr_disable ();
+  int64_t start_ticks = wheel_ticks;
+  uint64_t start = rdtsc ();
+  uint64_t cycles;
+
+  wheel_run (true);
+  cycles = rdtsc () - start;
+  wheel_cycles += cycles;
+  if (cycles > wheel_cycles_max)
+    wheel_cycles_max = cycles;
+  wheel_runs += wheel_ticks - start_ticks;
+  intr_set_level (old_level);
+}
+
+/* Files EVENT in the timer wheel slot that covers its expiry,
+   relative to wheel_ticks. */
+static void
+wheel_insert (struct timer_event *event)
+{
+  int64_t expires = event->expires;
+  int64_t delta = expires - wheel_ticks;
+  int level;
+
+  if (delta < 0)
+    expires = wheel_ticks;
+  else if (delta >> (WHEEL_BITS * WHEEL_LEVELS) != 0)
+    expires = wheel_ticks + (1 << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
+  delta = expires - wheel_ticks;
+
+  for (level = 0; level < WHEEL_LEVELS - 1; level++)
+    if (delta >> (WHEEL_BITS * (level + 1)) == 0)
+      break;
+  list_push_back (&wheel[level][(expires >> (WHEEL_BITS * level))
+                                & WHEEL_MASK],
+                  &event->elem);
+}
+
+/* Moves the events in slot SLOT of LEVEL down into lower levels.
+   Returns SLOT, so that the caller can tell whether this level
+   has wrapped around too. */
+static int
+wheel_cascade (int level, int slot)
+{
+  struct list *list = &wheel[level][slot];
+
+  while (!list_empty (list))
+    {
+      struct timer_event *event = list_entry (list_pop_front (list),
+                                              struct timer_event, elem);
+      wheel_insert (event);
+      events_cascaded++;
+    }
+  return slot;
+}
+
+/* Runs the timer wheel up to the current tick, firing each event
+   that is due.  An event further in the future than the wheel
+   spans is filed at the wheel's limit and filed again from
+   there when the limit comes around.  Event functions are called
+   with interrupts off; if PREEMPTIBLE, interrupts are let in
+   between events, so that a long run of them does not hold up
+   other devices. */
+static void
+wheel_run (bool preemptible)
+{
+  while (wheel_ticks <= ticks)
+    {
+      int slot = wheel_ticks & WHEEL_MASK;
+      struct list *list = &wheel[0][slot];
+      struct list due;
+      int level;
+
+      for (level = 1; slot == 0 && level < WHEEL_LEVELS; level++)
+        slot = wheel_cascade (level, (wheel_ticks >> (WHEEL_BITS * level))
+                                     & WHEEL_MASK);
+      wheel_ticks++;
+
+      /* Take the whole slot first, because an event's function
+         may add events of its own. */
+      list_init (&due);
+      if (!list_empty (list))
+        list_splice (list_end (&due), list_begin (list), list_end (list));
+      while (!list_empty (&due))
+        {
+          struct timer_event *event = list_entry (list_pop_front (&due),
+                                                  struct timer_event, elem);
+          if (event->expires > ticks)
+            {
+              wheel_insert (event);
+              continue;
+            }
+          event->pending = false;
+          events_fired++;
+          event->func (event->aux);
+          if (preemptible)
+            {
+              intr_enable ();
+              intr_disable ();
+            }
+        }
+    }
+}
+
+/* Returns true if LOOPS iterations waits for more than one timer
+   tick, otherwise false. */
+static bool
+too_many_loops (unsigned loops) 
+{
+  /* Wait for a timer tick. */
+  int64_t start = ticks;
+  while (ticks == start)
+    barrier ();
+
+  /* Run LOOPS loops. */
+  start = ticks;
+  busy_wait (loops);
+
+  /* If the tick count changed, we iterated too long. */
+  barrier ();
+  return start != ticks;
+}
+
+/* Iterates through a simple loop LOOPS times, for implementing
+   brief delays.
+
+   Marked NO_INLINE because code alignment can significantly
+   affect timings, so that if this function was inlined
+   differently in different places the results would be difficult
+   to predict. */
+static void NO_INLINE
+busy_wait (int64_t loops) 
+{
+  while (loops-- > 0)
+    barrier ();
+}
+
+/* Sleep for approximately NUM/DENOM seconds. */
+static void
+real_time_sleep (int64_t num, int32_t denom) 
+{
+  /* Convert NUM/DENOM seconds into timer ticks, rounding down.
+          
+        (NUM / DENOM) s          
+     ---------------------- = NUM * TIMER_FREQ / DENOM ticks. 
+     1 s / TIMER_FREQ ticks
+  */
+  int64_t ticks = num * TIMER_FREQ / denom;
+
+  ASSERT (intr_get_level () == INTR_ON);
+  if (ticks > 0)
+    {
+      /* We're waiting for at least one full timer tick.  Use
+         timer_sleep() because it will yield the CPU to other
+         processes. */                
+      timer_sleep (ticks); 
+    }
+  else 
+    {
+      /* Otherwise, use a busy-wait loop for more accurate
+         sub-tick timing. */
+      real_time_delay (num, denom); 
+    }
+}
+
+/* Busy-wait for approximately NUM/DENOM seconds. */
+static void
+real_time_delay (int64_t num, int32_t denom)
+{
+  /* Scale the numerator and denominator down by 1000 to avoid
+     the possibility of overflow. */
+  ASSERT (denom % 1000 == 0);
+  busy_wait (loops_per_tick * num / 1000 * TIMER_FREQ / (denom / 1000)); 
+}
@@ -0,0 +1,59 @@
+#ifndef DEVICES_TIMER_H
+#define DEVICES_TIMER_H
+
+#include <list.h>
+#include <round.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Number of timer interrupts per second. */
+#define TIMER_FREQ 100
+
+/* If true, stop the periodic tick while the CPU is idle.
+   Controlled by kernel command-line option "-tickless". */
+extern bool timer_tickless;
+
+void timer_init (void);
+void timer_calibrate (void);
+
+int64_t timer_ticks (void);
+int64_t timer_elapsed (int64_t);
+uint64_t timer_cycles_to_us (uint64_t cycles);
+uint64_t timer_us_to_cycles (uint64_t us);
+
+/* Sleep and yield the CPU to other threads. */
+void timer_sleep (int64_t ticks);
+void timer_msleep (int64_t milliseconds);
+void timer_usleep (int64_t microseconds);
+void timer_nsleep (int64_t nanoseconds);
+
+/* A one-shot timer.  Once timer_ticks() reaches EXPIRES, FUNC
+   is called with AUX from the timer interrupt, with interrupts
+   off. */
+typedef void timer_func (void *aux);
+struct timer_event
+  {
+    struct list_elem elem;      /* Element in a timer wheel slot. */
+    int64_t expires;            /* Tick at which to call FUNC. */
+    timer_func *func;           /* Function to call. */
+    void *aux;                  /* Argument to FUNC. */
+    bool pending;               /* True while in the timer wheel. */
+  };
+
+void timer_event_init (struct timer_event *, timer_func *, void *aux);
+void timer_event_add (struct timer_event *, int64_t expires);
+bool timer_event_cancel (struct timer_event *);
+
+/* Busy waits. */
+void timer_mdelay (int64_t milliseconds);
+void timer_udelay (int64_t microseconds);
+void timer_ndelay (int64_t nanoseconds);
+
+/* Tickless idle. */
+void timer_idle_enter (void);
+void timer_idle_exit (void);
+
+void timer_print_stats (void);
+void timer_bench (void);
+
+#endif /* devices/timer.h */
@@ -0,0 +1,163 @@
+#include "threads/trace.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <round.h>
+#include <stdio.h>
+#include "devices/serial.h"
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/tsc.h"
+#include "threads/vaddr.h"
+
+/* Number of events in the ring buffer.  Must be a power of 2. */
+#define TRACE_EVENTS 4096
+
+/* True while events are being recorded. */
+bool trace_enabled;
+
+/* Ring buffer.  trace_head counts every event ever reserved; the
+   event it names is stored at index trace_head % TRACE_EVENTS. */
+static struct trace_event *trace_buf;
+static uint32_t trace_head;
+
+/* Names of the event types, as shown by the trace viewer. */
+static const char *type_names[] =
+  {"switch", "wakeup", "block", "yield", "create", "exit"};
+
+/* Atomically increments *P and returns its old value. */
+static inline uint32_t
+fetch_and_inc (uint32_t *p)
+{
+  uint32_t old = 1;
+  asm volatile ("lock xaddl %0, %1" : "+r" (old), "+m" (*p) : : "memory");
+  return old;
+}
+
+/* Allocates the ring buffer and starts recording events. */
+void
+trace_init (void)
+{
+  size_t pages = DIV_ROUND_UP (TRACE_EVENTS * sizeof *trace_buf, PGSIZE);
+
+  trace_buf = palloc_get_multiple (PAL_ZERO, pages);
+  if (trace_buf == NULL)
+    {
+      printf ("trace: cannot allocate %zu pages, tracing disabled\n", pages);
+      return;
+    }
+  trace_enabled = true;
+}
+
+/* Records an event of TYPE about thread T, which involves thread
+   OTHER (which may be null).  This is the slow half of
+   trace_event(); it only reserves a slot and fills it in.  A
+   writer that interrupts another between the two still gets a
+   slot of its own. */
+void
+trace_record (enum trace_type type, const struct thread *t,
+              const struct thread *other)
+{
+  struct trace_event *e;
+
+  e = &trace_buf[fetch_and_inc (&trace_head) & (TRACE_EVENTS - 1)];
+  e->tsc = rdtsc ();
+  e->tid = t->tid;
+  e->priority = t->priority;
+  e->type = type;
+  if (other != NULL)
+    {
+      e->other = other->tid;
+      e->other_priority = other->priority;
+    }
+  else
+    {
+      e->other = TID_ERROR;
+      e->other_priority = 0;
+    }
+}
+
+/* Writes S to the serial port only, bypassing the console so
+   that a large dump does not scroll the VGA display for
+   minutes. */
+static void
+serial_puts (const char *s)
+{
+  while (*s != '\0')
+    serial_putc (*s++);
+}
+
+/* Writes the name of thread T as a trace viewer metadata
+   event. */
+static void
+dump_thread_name (struct thread *t, void *aux UNUSED)
+{
+  char buf[128];
+
+  snprintf (buf, sizeof buf,
+            "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,"
+            "\"args\":{\"name\":\"%s\"}},\n", t->tid, t->name);
+  serial_puts (buf);
+}
+
+/* Writes trace event E, with timestamp US, in Chrome trace
+   format.  A switch becomes the end of the previous thread's
+   "run" slice and the beginning of the next thread's; everything
+   else becomes an instant event. */
+static void
+dump_event (const struct trace_event *e, uint64_t us)
+{
+  char buf[192];
+
+  if (e->type == TRACE_SWITCH)
+    snprintf (buf, sizeof buf,
+              "{\"name\":\"run\",\"ph\":\"E\",\"pid\":0,\"tid\":%d,"
+              "\"ts\":%"PRIu64"},\n"
+              "{\"name\":\"run\",\"ph\":\"B\",\"pid\":0,\"tid\":%d,"
+              "\"ts\":%"PRIu64",\"args\":{\"priority\":%d}},\n",
+              e->tid, us, e->other, us, e->other_priority);
+  else
+    snprintf (buf, sizeof buf,
+              "{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":0,"
+              "\"tid\":%d,\"ts\":%"PRIu64",\"args\":{\"priority\":%d,"
+              "\"other\":%d}},\n",
+              type_names[e->type], e->tid, us, e->priority, e->other);
+  serial_puts (buf);
+}
+
+/* Writes the contents of the ring buffer to the serial port as
+   Chrome trace JSON, oldest event first.  Recording is paused
+   while the dump runs. */
+void
+trace_dump (void)
+{
+  enum intr_level old_level;
+  uint32_t head, first, i;
+  uint64_t base;
+
+  if (trace_buf == NULL)
+    {
+      printf ("Tracing is not enabled (boot with -trace).\n");
+      return;
+    }
+
+  trace_enabled = false;
+  head = trace_head;
+  first = head > TRACE_EVENTS ? head - TRACE_EVENTS : 0;
+  base = trace_buf[first & (TRACE_EVENTS - 1)].tsc;
+  printf ("Dumping %"PRIu32" trace events to the serial port...\n",
+          head - first);
+
+  serial_puts ("{\"traceEvents\":[\n");
+  old_level = intr_disable ();
+  thread_foreach (dump_thread_name, NULL);
+  intr_set_level (old_level);
+  for (i = first; i != head; i++)
+    {
+      const struct trace_event *e = &trace_buf[i & (TRACE_EVENTS - 1)];
+      dump_event (e, timer_cycles_to_us (e->tsc - base));
+    }
+  serial_puts ("{}]}\n");
+
+  trace_enabled = true;
+}
@@ -0,0 +1,56 @@
+#ifndef THREADS_TRACE_H
+#define THREADS_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "threads/thread.h"
+
+/* Scheduler event trace.
+
+   When enabled with the "-trace" kernel command-line option,
+   the scheduler records its decisions in a fixed-size ring
+   buffer, overwriting the oldest events once it fills up.
+   trace_dump() writes the buffer to the serial port as Chrome
+   trace JSON, which chrome://tracing and Perfetto can load. */
+
+/* Types of traced events. */
+enum trace_type
+  {
+    TRACE_SWITCH,               /* TID gave up the CPU to OTHER. */
+    TRACE_WAKEUP,               /* OTHER woke up TID. */
+    TRACE_BLOCK,                /* TID blocked. */
+    TRACE_YIELD,                /* TID yielded the CPU. */
+    TRACE_CREATE,               /* OTHER created TID. */
+    TRACE_EXIT                  /* TID exited. */
+  };
+
+/* One traced event. */
+struct trace_event
+  {
+    uint64_t tsc;               /* Time-stamp counter. */
+    tid_t tid;                  /* Thread the event is about. */
+    tid_t other;                /* Other thread involved, if any. */
+    uint8_t type;               /* A TRACE_* value. */
+    uint8_t priority;           /* TID's priority. */
+    uint8_t other_priority;     /* OTHER's priority. */
+  };
+
+extern bool trace_enabled;
+
+void trace_init (void);
+void trace_record (enum trace_type, const struct thread *,
+                   const struct thread *other);
+void trace_dump (void);
+
+/* Records an event of TYPE about thread T, which involves thread
+   OTHER (which may be null), if tracing is enabled.  May be
+   called in any context. */
+static inline void
+trace_event (enum trace_type type, const struct thread *t,
+             const struct thread *other)
+{
+  if (trace_enabled)
+    trace_record (type, t, other);
+}
+
+#endif /* threads/trace.h */
@@ -0,0 +1,19 @@
+#ifndef THREADS_TSC_H
+#define THREADS_TSC_H
+
+#include <stdint.h>
+
+/* Returns the CPU's time-stamp counter, which counts clock
+   cycles since reset.  Reading it takes a few dozen cycles, so
+   it is cheap enough for per-switch accounting.  See [IA32-v2b]
+   "RDTSC".  timer_cycles_to_us() converts a cycle count to
+   microseconds. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint32_t lo, hi;
+  asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t) hi << 32) | lo;
+}
+
+#endif /* threads/tsc.h */
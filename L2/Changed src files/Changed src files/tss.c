@@ -0,0 +1,161 @@
+#include "userprog/tss.h"
+#include <debug.h>
+#include <stddef.h>
+#include "userprog/gdt.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* The Task-State Segment (TSS).
+
+   Instances of the TSS, an x86-specific structure, are used to
+   define "tasks", a form of support for multitasking built right
+   into the processor.  However, for various reasons including
+   portability, speed, and flexibility, most x86 OSes almost
+   completely ignore the TSS.  We are no exception.
+
+   Unfortunately, there is one thing that can only be done using
+   a TSS: stack switching for interrupts that occur in user mode.
+   When an interrupt occurs in user mode (ring 3), the processor
+   consults the ss0 and esp0 members of the current TSS to
+   determine the stack to use for handling the interrupt.  Thus,
+   we must create a TSS and initialize at least these fields, and
+   this is precisely what this file does.
+
+   When an interrupt is handled by an interrupt or trap gate
+   (which applies to all interrupts we handle), an x86 processor
+   works like this:
+
+     - If the code interrupted by the interrupt is in the same
+       ring as the interrupt handler, then no stack switch takes
+       place.  This is the case for interrupts that happen when
+       we're running in the kernel.  The contents of the TSS are
+       irrelevant for this case.
+
+     - If the interrupted code is in a different ring from the
+       handler, then the processor switches to the stack
+       specified in the TSS for the new ring.  This is the case
+       for interrupts that happen when we're in user space.  It's
+       important that we switch to a stack that's not already in
+       use, to avoid corruption.  Because we're running in user
+       space, we know that the current process's kernel stack is
+       not in use, so we can always use that.  Thus, when the
+       scheduler switches threads, it also changes the TSS's
+       stack pointer to point to the new thread's kernel stack.
+       (The call is in process_activate() in process.c.)
+
+   There is one more thing a TSS is good for: a double fault,
+   which the CPU raises when it cannot deliver another exception,
+   typically because a kernel stack has overflowed into its guard
+   page, so that there is nowhere to push the exception frame.
+   No handler can run on that stack, so vector 8 is a task gate
+   instead, and the CPU switches to a separate double-fault task
+   with a stack of its own.  The task switch saves the faulting
+   state in the kernel TSS, which is how the handler finds it.
+
+   See [IA32-v3a] 6.2.1 "Task-State Segment (TSS)" for a
+   description of the TSS.  See [IA32-v3a] 5.12.1 "Exception- or
+   Interrupt-Handler Procedures" for a description of when and
+   how stack switching occurs during an interrupt, and 5.12.2
+   "Interrupt Tasks" for task gates. */
+struct tss
+  {
+    uint16_t back_link, :16;
+    void *esp0;                         /* Ring 0 stack virtual address. */
+    uint16_t ss0, :16;                  /* Ring 0 stack segment selector. */
+    void *esp1;
+    uint16_t ss1, :16;
+    void *esp2;
+    uint16_t ss2, :16;
+    uint32_t cr3;
+    void (*eip) (void);
+    uint32_t eflags;
+    uint32_t eax, ecx, edx, ebx;
+    uint32_t esp, ebp, esi, edi;
+    uint16_t es, :16;
+    uint16_t cs, :16;
+    uint16_t ss, :16;
+    uint16_t ds, :16;
+    uint16_t fs, :16;
+    uint16_t gs, :16;
+    uint16_t ldt, :16;
+    uint16_t trace, bitmap;
+  };
+
+/* Kernel TSS. */
+static struct tss *tss;
+
+/* Double-fault task's TSS and stack. */
+static struct tss *df_tss;
+static uint8_t *df_stack;
+
+/* Initializes the kernel TSS and allocates the double-fault
+   task's. */
+void
+tss_init (void)
+{
+  /* Our TSS is never used in a call gate or task gate, so only a
+     few fields of it are ever referenced, and those are the only
+     ones we initialize. */
+  tss = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+  tss->ss0 = SEL_KDSEG;
+  tss->bitmap = 0xdfff;
+  tss_update ();
+
+  df_tss = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+  df_stack = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+}
+
+/* Returns the kernel TSS. */
+struct tss *
+tss_get (void)
+{
+  ASSERT (tss != NULL);
+  return tss;
+}
+
+/* Sets the ring 0 stack pointer in the TSS to point to the end
+   of the thread stack. */
+void
+tss_update (void)
+{
+  ASSERT (tss != NULL);
+  tss->esp0 = thread_current ()->kstack_top;
+}
+
+/* Returns the double-fault task's TSS. */
+struct tss *
+tss_get_double_fault (void)
+{
+  ASSERT (df_tss != NULL);
+  return df_tss;
+}
+
+/* Sets up the double-fault task to run HANDLER, which must never
+   return, with interrupts off, in the kernel's address space. */
+void
+tss_init_double_fault (void (*handler) (void))
+{
+  ASSERT (df_tss != NULL);
+
+  df_tss->cr3 = vtop (init_page_dir);
+  df_tss->eip = handler;
+  df_tss->eflags = 0x2;                 /* Reserved bit; IF clear. */
+  df_tss->esp = (uint32_t) (df_stack + PGSIZE);
+  df_tss->cs = SEL_KCSEG;
+  df_tss->ss = df_tss->ds = df_tss->es = SEL_KDSEG;
+  df_tss->fs = df_tss->gs = SEL_KDSEG;
+  df_tss->bitmap = 0xdfff;
+}
+
+/* Stores in *EIP and *ESP the instruction and stack pointers at
+   the time of the last double fault.  Only meaningful within the
+   double-fault task. */
+void
+tss_get_fault_state (void **eip, void **esp)
+{
+  ASSERT (tss != NULL);
+  *eip = tss->eip;
+  *esp = (void *) tss->esp;
+}
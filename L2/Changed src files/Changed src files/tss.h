@@ -0,0 +1,15 @@
+#ifndef USERPROG_TSS_H
+#define USERPROG_TSS_H
+
+#include <stdint.h>
+
+struct tss;
+void tss_init (void);
+struct tss *tss_get (void);
+void tss_update (void);
+
+struct tss *tss_get_double_fault (void);
+void tss_init_double_fault (void (*handler) (void));
+void tss_get_fault_state (void **eip, void **esp);
+
+#endif /* userprog/tss.h */
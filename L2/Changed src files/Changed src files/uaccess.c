@@ -0,0 +1,132 @@
+#include "userprog/uaccess.h"
+#include <debug.h>
+#include "threads/vaddr.h"
+
+/* An exception table entry: if the instruction at INSN faults,
+   page_fault() resumes execution at FIXUP. */
+struct exception_entry
+  {
+    uintptr_t insn;
+    uintptr_t fixup;
+  };
+
+/* Bounds of the exception table.  The linker provides these
+   symbols for the "ex_table" section, whose name is a valid C
+   identifier. */
+extern const struct exception_entry __start_ex_table[];
+extern const struct exception_entry __stop_ex_table[];
+
+/* Assembler text that adds an exception table entry for the
+   instruction at label INSN, to resume at label FIXUP. */
+#define EX_TABLE_ENTRY(INSN, FIXUP)             \
+        ".pushsection ex_table, \"a\"\n"        \
+        ".balign 4\n"                           \
+        ".long " INSN ", " FIXUP "\n"           \
+        ".popsection\n"
+
+/* Returns true if the SIZE bytes starting at UADDR all lie below
+   PHYS_BASE. */
+static bool
+is_user_range (const void *uaddr, size_t size)
+{
+  uintptr_t start = (uintptr_t) uaddr;
+  uintptr_t end = start + size;
+
+  return end >= start && end <= (uintptr_t) PHYS_BASE;
+}
+
+/* Copies SIZE bytes from SRC to DST, one of which is in user
+   memory.  Returns the number of bytes that were not copied,
+   which is nonzero only if an access faulted.  "rep movsb" can
+   be interrupted by a fault part way; ECX then holds the count
+   still to go, and the fixup just carries on after it. */
+static size_t
+copy_user (void *dst, const void *src, size_t size)
+{
+  asm volatile ("1: rep movsb\n"
+                "2:\n"
+                EX_TABLE_ENTRY ("1b", "2b")
+                : "+c" (size), "+D" (dst), "+S" (src)
+                :
+                : "memory");
+  return size;
+}
+
+/* Reads the byte at user address UADDR, which must be below
+   PHYS_BASE.  Returns the byte, or -1 if the access faulted. */
+static inline int
+get_user (const uint8_t *uaddr)
+{
+  int result;
+
+  asm volatile ("1: movzbl %1, %0\n"
+                "   jmp 3f\n"
+                "2: movl $-1, %0\n"
+                "3:\n"
+                EX_TABLE_ENTRY ("1b", "2b")
+                : "=&r" (result)
+                : "m" (*uaddr));
+  return result;
+}
+
+/* Copies SIZE bytes from user address USRC to kernel buffer DST.
+   Returns true if successful, false if any of the source bytes
+   is not mapped user memory, in which case DST holds an
+   unspecified part of the data. */
+bool
+copy_from_user (void *dst, const void *usrc, size_t size)
+{
+  return is_user_range (usrc, size) && copy_user (dst, usrc, size) == 0;
+}
+
+/* Copies SIZE bytes from kernel buffer SRC to user address UDST.
+   Returns true if successful, false if any of the destination
+   bytes is not writable user memory, in which case only part of
+   the data may have been written. */
+bool
+copy_to_user (void *udst, const void *src, size_t size)
+{
+  return is_user_range (udst, size) && copy_user (udst, src, size) == 0;
+}
+
+/* Copies the null-terminated string at user address USRC into
+   DST, which is SIZE bytes long.  Returns the length of the
+   string, not counting the null terminator, if it fit.  Returns
+   SIZE, with DST not terminated, if the string is SIZE bytes or
+   longer, or -1 if it runs into memory that is not mapped user
+   memory. */
+int
+strncpy_from_user (char *dst, const char *usrc, size_t size)
+{
+  const uint8_t *u = (const uint8_t *) usrc;
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    {
+      int c;
+
+      if (!is_user_vaddr (u + i))
+        return -1;
+      c = get_user (u + i);
+      if (c < 0)
+        return -1;
+      dst[i] = c;
+      if (c == '\0')
+        return i;
+    }
+  return size;
+}
+
+/* Returns the address at which to resume after a fault at EIP
+   in the kernel, or 0 if EIP is not an instruction that accesses
+   user memory on the kernel's behalf. */
+uintptr_t
+uaccess_fixup (uintptr_t eip)
+{
+  const struct exception_entry *e;
+
+  for (e = __start_ex_table; e < __stop_ex_table; e++)
+    if (e->insn == eip)
+      return e->fixup;
+  return 0;
+}
@@ -0,0 +1,25 @@
+#ifndef USERPROG_UACCESS_H
+#define USERPROG_UACCESS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Access to user memory from the kernel.
+
+   These routines touch user memory directly, through the page
+   directory of the running process, instead of checking each
+   page with pagedir_get_page() first.  An access to an unmapped
+   or read-only page faults, and page_fault() resumes execution at
+   a fixup address recorded next to the faulting instruction in
+   the exception table, which makes the routine report failure.
+   Addresses at or above PHYS_BASE are rejected before any
+   access, since kernel memory would not fault. */
+
+bool copy_from_user (void *dst, const void *usrc, size_t size);
+bool copy_to_user (void *udst, const void *src, size_t size);
+int strncpy_from_user (char *dst, const char *usrc, size_t size);
+
+uintptr_t uaccess_fixup (uintptr_t eip);
+
+#endif /* userprog/uaccess.h */
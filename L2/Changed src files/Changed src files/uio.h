@@ -0,0 +1,21 @@
+#ifndef __LIB_USER_UIO_H
+#define __LIB_USER_UIO_H
+
+#include <iovec.h>
+#include <uring.h>
+
+/* Vectored I/O.  readv() fills the IOVCNT buffers in IOV in
+   order from file FD, and writev() writes them to FD in order,
+   each as one read or write of their total length.  Both return
+   the number of bytes transferred, or -1 on error. */
+int readv (int fd, const struct iovec *iov, int iovcnt);
+int writev (int fd, const struct iovec *iov, int iovcnt);
+
+/* Batched system calls; see <uring.h>.  uring_setup() registers
+   the rings in URING and returns 0, or -1 if its entry count is
+   bad.  uring_enter() runs up to TO_SUBMIT submitted operations
+   and returns the number run, or -1 if no rings are registered. */
+int uring_setup (struct uring *uring);
+int uring_enter (unsigned to_submit);
+
+#endif /* lib/user/uio.h */
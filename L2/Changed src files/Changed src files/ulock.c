@@ -0,0 +1,239 @@
+#include "ulock.h"
+#include <limits.h>
+#include <syscall-nr.h>
+
+/* Invokes syscall NUMBER, passing no arguments, and returns the
+   return value as an `int'.  Same as the macros in syscall.c,
+   which keeps them private. */
+#define syscall0(NUMBER)                                        \
+        ({                                                      \
+          int retval;                                           \
+          asm volatile                                          \
+            ("pushl %[number]; int $0x30; addl $4, %%esp"       \
+               : "=a" (retval)                                  \
+               : [number] "i" (NUMBER)                          \
+               : "memory");                                     \
+          retval;                                               \
+        })
+
+/* Invokes syscall NUMBER, passing argument ARG0, and returns the
+   return value as an `int'. */
+#define syscall1(NUMBER, ARG0)                                  \
+        ({                                                      \
+          int retval;                                           \
+          asm volatile                                          \
+            ("pushl %[arg0]; pushl %[number]; int $0x30; addl $8, %%esp" \
+               : "=a" (retval)                                  \
+               : [number] "i" (NUMBER),                         \
+                 [arg0] "g" (ARG0)                              \
+               : "memory");                                     \
+          retval;                                               \
+        })
+
+/* Invokes syscall NUMBER, passing arguments ARG0 and ARG1, and
+   returns the return value as an `int'. */
+#define syscall2(NUMBER, ARG0, ARG1)                            \
+        ({                                                      \
+          int retval;                                           \
+          asm volatile                                          \
+            ("pushl %[arg1]; pushl %[arg0]; "                   \
+             "pushl %[number]; int $0x30; addl $12, %%esp"      \
+               : "=a" (retval)                                  \
+               : [number] "i" (NUMBER),                         \
+                 [arg0] "r" (ARG0),                             \
+                 [arg1] "r" (ARG1)                              \
+               : "memory");                                     \
+          retval;                                               \
+        })
+
+/* Invokes syscall NUMBER, passing arguments ARG0, ARG1, and
+   ARG2, and returns the return value as an `int'. */
+#define syscall3(NUMBER, ARG0, ARG1, ARG2)                      \
+        ({                                                      \
+          int retval;                                           \
+          asm volatile                                          \
+            ("pushl %[arg2]; pushl %[arg1]; pushl %[arg0]; "    \
+             "pushl %[number]; int $0x30; addl $16, %%esp"      \
+               : "=a" (retval)                                  \
+               : [number] "i" (NUMBER),                         \
+                 [arg0] "r" (ARG0),                             \
+                 [arg1] "r" (ARG1),                             \
+                 [arg2] "r" (ARG2)                              \
+               : "memory");                                     \
+          retval;                                               \
+        })
+
+int
+futex_wait (int *addr, int expected, int timeout_ms)
+{
+  return syscall3 (SYS_FUTEX_WAIT, addr, expected, timeout_ms);
+}
+
+int
+futex_wake (int *addr, int n)
+{
+  return syscall2 (SYS_FUTEX_WAKE, addr, n);
+}
+
+/* Runs in a new thread, as set up by the kernel: calls FUNC and
+   ends the thread when it returns. */
+static void
+uthread_start (uthread_func *func, void *aux)
+{
+  func (aux);
+  uthread_exit ();
+}
+
+/* Starts a new thread running FUNC (AUX).  Returns its id, or -1
+   if it cannot be created. */
+uthread_t
+uthread_create (uthread_func *func, void *aux)
+{
+  return syscall3 (SYS_THREAD_CREATE, uthread_start, func, aux);
+}
+
+/* Waits for thread T, which the caller created, to end.  Returns
+   0 if successful, -1 if T cannot be joined. */
+int
+uthread_join (uthread_t t)
+{
+  return syscall1 (SYS_THREAD_JOIN, t);
+}
+
+/* Ends the calling thread. */
+void
+uthread_exit (void)
+{
+  syscall0 (SYS_THREAD_EXIT);
+  NOT_REACHED ();
+}
+
+/* Atomically sets *ADDR to NEW if it equals OLD.  Returns the
+   previous value of *ADDR either way.  CMPXCHG needs an 80486,
+   which is why we don't rely on the compiler's builtins. */
+static inline int
+atomic_cmpxchg (int *addr, int old, int new)
+{
+  int prev;
+  asm volatile ("lock cmpxchgl %2, %1"
+                : "=a" (prev), "+m" (*addr)
+                : "r" (new), "0" (old)
+                : "memory");
+  return prev;
+}
+
+/* Atomically stores NEW in *ADDR and returns the old value.
+   XCHG with a memory operand is locked implicitly. */
+static inline int
+atomic_xchg (int *addr, int new)
+{
+  asm volatile ("xchgl %0, %1" : "+r" (new), "+m" (*addr) : : "memory");
+  return new;
+}
+
+/* Atomically adds 1 to *ADDR. */
+static inline void
+atomic_inc (int *addr)
+{
+  asm volatile ("lock incl %0" : "+m" (*addr) : : "memory");
+}
+
+/* Initializes M as free. */
+void
+umutex_init (struct umutex *m)
+{
+  m->state = 0;
+}
+
+/* Acquires M, sleeping until it is free if necessary.
+
+   This is the third mutex in Drepper's "Futexes Are Tricky".  A
+   contended mutex is marked 2, so that its holder knows it must
+   make a futex_wake() call on release.  A thread that had to
+   wait cannot tell whether others are still waiting, so it also
+   takes the mutex as 2. */
+void
+umutex_lock (struct umutex *m)
+{
+  int c = atomic_cmpxchg (&m->state, 0, 1);
+
+  if (c == 0)
+    return;
+  if (c != 2)
+    c = atomic_xchg (&m->state, 2);
+  while (c != 0)
+    {
+      futex_wait (&m->state, 2, -1);
+      c = atomic_xchg (&m->state, 2);
+    }
+}
+
+/* Acquires M if it is free, without sleeping.  Returns true if
+   successful. */
+bool
+umutex_trylock (struct umutex *m)
+{
+  return atomic_cmpxchg (&m->state, 0, 1) == 0;
+}
+
+/* Releases M, which the caller must hold, and wakes a waiter if
+   there might be one. */
+void
+umutex_unlock (struct umutex *m)
+{
+  if (atomic_xchg (&m->state, 0) == 2)
+    futex_wake (&m->state, 1);
+}
+
+/* Initializes condition variable C. */
+void
+ucond_init (struct ucond *c)
+{
+  c->seq = 0;
+}
+
+/* Atomically releases M and waits for C to be signaled, then
+   reacquires M.  M must be held.  As with any condition
+   variable, the caller must recheck its condition on return. */
+void
+ucond_wait (struct ucond *c, struct umutex *m)
+{
+  ucond_timedwait (c, m, -1);
+}
+
+/* Like ucond_wait(), but gives up after TIMEOUT_MS milliseconds,
+   or never if TIMEOUT_MS is negative.  Returns false if the wait
+   timed out.
+
+   A signal that comes between releasing M and sleeping changes
+   C's sequence number, so futex_wait() returns at once instead of
+   missing it.  M is reacquired as contended, since other threads
+   woken by a broadcast may be queued on it. */
+bool
+ucond_timedwait (struct ucond *c, struct umutex *m, int timeout_ms)
+{
+  int seq = c->seq;
+  int result;
+
+  umutex_unlock (m);
+  result = futex_wait (&c->seq, seq, timeout_ms);
+  while (atomic_xchg (&m->state, 2) != 0)
+    futex_wait (&m->state, 2, -1);
+  return result != -1;
+}
+
+/* Wakes one thread waiting on C, if any. */
+void
+ucond_signal (struct ucond *c)
+{
+  atomic_inc (&c->seq);
+  futex_wake (&c->seq, 1);
+}
+
+/* Wakes all threads waiting on C. */
+void
+ucond_broadcast (struct ucond *c)
+{
+  atomic_inc (&c->seq);
+  futex_wake (&c->seq, INT_MAX);
+}
@@ -0,0 +1,62 @@
+#ifndef __LIB_USER_ULOCK_H
+#define __LIB_USER_ULOCK_H
+
+#include <debug.h>
+#include <stdbool.h>
+
+/* User-level threads, and locks and condition variables for them
+   built on futexes.
+
+   Taking a free mutex or releasing one that nobody waits for is
+   a single atomic instruction, with no system call.  Only a
+   thread that has to wait, or that releases a mutex or signals a
+   condition that someone waits on, calls into the kernel. */
+
+/* Futex system calls.  futex_wait() returns 0 if woken, 1 if
+   *ADDR did not hold EXPECTED, or -1 if TIMEOUT_MS (negative for
+   no timeout) expired.  futex_wake() returns the number of
+   threads woken. */
+int futex_wait (int *addr, int expected, int timeout_ms);
+int futex_wake (int *addr, int n);
+
+/* Threads.  A thread runs FUNC (AUX) on a user stack of its own
+   and shares everything else with the rest of its process.  It
+   ends when FUNC returns or it calls uthread_exit(), and the
+   process ends when its last thread does.  exit() ends every
+   thread of the process.  Only the thread that created a thread
+   may join it. */
+typedef int uthread_t;
+typedef void uthread_func (void *aux);
+
+uthread_t uthread_create (uthread_func *, void *aux);
+int uthread_join (uthread_t);
+void uthread_exit (void) NO_RETURN;
+
+/* Mutex. */
+struct umutex
+  {
+    int state;                  /* 0: free, 1: held, 2: held, maybe waiters. */
+  };
+
+#define UMUTEX_INITIALIZER { 0 }
+
+void umutex_init (struct umutex *);
+void umutex_lock (struct umutex *);
+bool umutex_trylock (struct umutex *);
+void umutex_unlock (struct umutex *);
+
+/* Condition variable. */
+struct ucond
+  {
+    int seq;                    /* Bumped by each signal or broadcast. */
+  };
+
+#define UCOND_INITIALIZER { 0 }
+
+void ucond_init (struct ucond *);
+void ucond_wait (struct ucond *, struct umutex *);
+bool ucond_timedwait (struct ucond *, struct umutex *, int timeout_ms);
+void ucond_signal (struct ucond *);
+void ucond_broadcast (struct ucond *);
+
+#endif /* lib/user/ulock.h */
@@ -0,0 +1,68 @@
+#ifndef __LIB_URING_H
+#define __LIB_URING_H
+
+#include <stdint.h>
+
+/* Submission and completion rings for batched system calls.
+
+   A process places a struct uring and two arrays of ENTRIES
+   elements each in its own memory, and registers them with
+   uring_setup().  To submit operations, it fills in entries of
+   SQES at index SQ_TAIL % ENTRIES and advances SQ_TAIL.  Then it
+   calls uring_enter(), which runs the submitted operations in
+   order, advancing SQ_HEAD, and posts a completion for each to
+   CQES at index CQ_TAIL % ENTRIES, advancing CQ_TAIL.  The
+   process consumes completions and advances CQ_HEAD.  The
+   kernel stops taking submissions while the completion ring is
+   full.
+
+   Each operation behaves like the system call of the same name,
+   except that a bad pointer, file name or file descriptor makes
+   its result -1 instead of killing the process.  A ring cannot
+   read from the keyboard.  If several threads of a process call
+   uring_enter() at once, the calls run one after another. */
+
+/* Maximum number of entries in each ring. */
+#define URING_ENTRIES_MAX 1024
+
+/* Operations. */
+enum uring_op
+  {
+    URING_NOP,                  /* Do nothing; result 0. */
+    URING_READ,                 /* read (fd, addr, len). */
+    URING_WRITE,                /* write (fd, addr, len). */
+    URING_SEEK,                 /* seek (fd, len); result 0 or -1. */
+    URING_OPEN,                 /* open (addr). */
+    URING_CLOSE                 /* close (fd); result 0 or -1. */
+  };
+
+/* Submission queue entry. */
+struct uring_sqe
+  {
+    int opcode;                 /* A URING_* value. */
+    int fd;                     /* File descriptor. */
+    void *addr;                 /* Buffer or file name. */
+    unsigned len;               /* Buffer length or file position. */
+    uint32_t user_data;         /* Copied to the completion. */
+  };
+
+/* Completion queue entry. */
+struct uring_cqe
+  {
+    uint32_t user_data;         /* From the submission. */
+    int res;                    /* Result, or -1 on error. */
+  };
+
+/* A pair of rings. */
+struct uring
+  {
+    unsigned entries;           /* Entries in each ring, a power of 2. */
+    struct uring_sqe *sqes;     /* Submission ring. */
+    struct uring_cqe *cqes;     /* Completion ring. */
+    unsigned sq_head;           /* Next submission to run; kernel. */
+    unsigned sq_tail;           /* Next free submission; process. */
+    unsigned cq_head;           /* Next completion to consume; process. */
+    unsigned cq_tail;           /* Next free completion; kernel. */
+  };
+
+#endif /* lib/uring.h */
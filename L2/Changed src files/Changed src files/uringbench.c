@@ -0,0 +1,123 @@
+/* uringbench.c
+
+   Measures operations per second for OPS small writes to a file
+   made with one write() call each, against the same writes
+   submitted BATCH at a time through the rings of <uring.h>.
+   Also measures ring operations that do nothing, which shows
+   the cost of the rings themselves.  Usage: uringbench. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include <uio.h>
+#include "bench.h"
+
+#define OPS 4096                /* Operations per method. */
+#define BATCH 64                /* Operations per uring_enter(). */
+#define WRITE_SIZE 16           /* Bytes per write. */
+#define FILE_SIZE 4096          /* Writes wrap around at this offset. */
+
+static const char file_name[] = "uringbench";
+static char data[WRITE_SIZE];
+
+static struct uring_sqe sqes[BATCH];
+static struct uring_cqe cqes[BATCH];
+static struct uring ring;
+
+/* Prints the cost of OPS operations that took CYCLES, for
+   METHOD. */
+static void
+report (const char *method, uint64_t cycles, uint64_t hz)
+{
+  printf ("%-7s %d ops: %llu cycles/op, %llu ops/s\n", method, OPS,
+          cycles / OPS, cycles != 0 ? OPS * hz / cycles : 0);
+}
+
+/* Submits OPS operations through the rings, BATCH at a time,
+   each a write of DATA to FD if WRITE, otherwise a no-op.
+   Returns the cycles taken, or 0 if an operation failed. */
+static uint64_t
+run_ring (int fd, bool write)
+{
+  uint64_t start = bench_cycles ();
+  int done, i;
+
+  for (done = 0; done < OPS; done += BATCH)
+    {
+      if (write && done * WRITE_SIZE % FILE_SIZE == 0)
+        seek (fd, 0);
+      for (i = 0; i < BATCH; i++)
+        {
+          struct uring_sqe *sqe = &sqes[ring.sq_tail % BATCH];
+          sqe->opcode = write ? URING_WRITE : URING_NOP;
+          sqe->fd = fd;
+          sqe->addr = data;
+          sqe->len = WRITE_SIZE;
+          sqe->user_data = done + i;
+          ring.sq_tail++;
+        }
+      if (uring_enter (BATCH) != BATCH)
+        return 0;
+      for (; ring.cq_head != ring.cq_tail; ring.cq_head++)
+        if (cqes[ring.cq_head % BATCH].res != (write ? WRITE_SIZE : 0))
+          return 0;
+    }
+  return bench_cycles () - start;
+}
+
+int
+main (void)
+{
+  uint64_t start, cycles, hz;
+  int fd, i;
+
+  memset (data, 'u', sizeof data);
+  remove (file_name);
+  if (!create (file_name, FILE_SIZE) || (fd = open (file_name)) < 0)
+    {
+      printf ("uringbench: cannot create %s\n", file_name);
+      return EXIT_FAILURE;
+    }
+  ring.entries = BATCH;
+  ring.sqes = sqes;
+  ring.cqes = cqes;
+  if (uring_setup (&ring) != 0)
+    {
+      printf ("uringbench: uring_setup failed\n");
+      return EXIT_FAILURE;
+    }
+  hz = bench_hz ();
+
+  start = bench_cycles ();
+  for (i = 0; i < OPS; i++)
+    {
+      if (i * WRITE_SIZE % FILE_SIZE == 0)
+        seek (fd, 0);
+      if (write (fd, data, WRITE_SIZE) != WRITE_SIZE)
+        {
+          printf ("uringbench: write failed\n");
+          return EXIT_FAILURE;
+        }
+    }
+  report ("write", bench_cycles () - start, hz);
+
+  cycles = run_ring (fd, true);
+  if (cycles == 0)
+    {
+      printf ("uringbench: ring write failed\n");
+      return EXIT_FAILURE;
+    }
+  report ("uring", cycles, hz);
+
+  cycles = run_ring (fd, false);
+  if (cycles == 0)
+    {
+      printf ("uringbench: ring no-op failed\n");
+      return EXIT_FAILURE;
+    }
+  report ("nop", cycles, hz);
+
+  close (fd);
+  return EXIT_SUCCESS;
+}
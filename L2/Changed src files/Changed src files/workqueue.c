@@ -0,0 +1,151 @@
+#include "threads/workqueue.h"
+#include <debug.h>
+#include <stdio.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+#include "threads/tsc.h"
+
+/* General-purpose workqueue. */
+struct workqueue system_wq;
+
+/* All workqueues, for statistics. */
+static struct list workqueues = LIST_INITIALIZER (workqueues);
+
+static thread_func worker;
+
+/* Creates the general-purpose workqueue.  Must be called after
+   thread_start(). */
+void
+workqueue_init (void)
+{
+  if (!workqueue_create (&system_wq, "events", PRI_DEFAULT))
+    PANIC ("cannot create system workqueue");
+}
+
+/* Initializes WQ, named NAME, and starts its worker thread at
+   PRIORITY.  Returns false if the thread cannot be created. */
+bool
+workqueue_create (struct workqueue *wq, const char *name, int priority)
+{
+  enum intr_level old_level;
+
+  wq->name = name;
+  list_init (&wq->items);
+  sema_init (&wq->ready, 0);
+  wq->depth = wq->max_depth = 0;
+  wq->runs = 0;
+  wq->cycles = wq->max_cycles = 0;
+  if (thread_create (name, priority, worker, wq) == TID_ERROR)
+    return false;
+
+  old_level = intr_disable ();
+  list_push_back (&workqueues, &wq->elem);
+  intr_set_level (old_level);
+  return true;
+}
+
+/* Initializes work item W to call FUNC with AUX. */
+void
+work_init (struct work *w, work_func *func, void *aux)
+{
+  ASSERT (w != NULL);
+  ASSERT (func != NULL);
+
+  w->func = func;
+  w->aux = aux;
+  w->pending = false;
+}
+
+/* Adds W to the tail of WQ, unless it is already pending.
+   Returns true if W was added.
+
+   This function may be called from an interrupt handler or with
+   interrupts off; it does not yield outside of an interrupt. */
+bool
+work_queue (struct workqueue *wq, struct work *w)
+{
+  enum intr_level old_level;
+
+  ASSERT (wq != NULL && w != NULL);
+
+  old_level = intr_disable ();
+  if (w->pending)
+    {
+      intr_set_level (old_level);
+      return false;
+    }
+  w->pending = true;
+  list_push_back (&wq->items, &w->elem);
+  if (++wq->depth > wq->max_depth)
+    wq->max_depth = wq->depth;
+  sema_up (&wq->ready);
+  intr_set_level (old_level);
+  return true;
+}
+
+/* Worker thread for workqueue WQ_.  Runs the queued items one at
+   a time, in the order they were queued. */
+static void
+worker (void *wq_)
+{
+  struct workqueue *wq = wq_;
+
+  for (;;)
+    {
+      struct work *w;
+      work_func *func;
+      void *aux;
+      enum intr_level old_level;
+      uint64_t start, cycles;
+
+      sema_down (&wq->ready);
+
+      old_level = intr_disable ();
+      w = list_entry (list_pop_front (&wq->items), struct work, elem);
+      w->pending = false;
+      func = w->func;
+      aux = w->aux;
+      wq->depth--;
+      intr_set_level (old_level);
+
+      start = rdtsc ();
+      func (aux);
+      cycles = rdtsc () - start;
+
+      old_level = intr_disable ();
+      wq->runs++;
+      wq->cycles += cycles;
+      if (cycles > wq->max_cycles)
+        wq->max_cycles = cycles;
+      intr_set_level (old_level);
+    }
+}
+
+/* Prints each workqueue's depth and the run time of its items,
+   along with softirq statistics. */
+void
+workqueue_print_stats (void)
+{
+  struct list_elem *e;
+
+  softirq_print_stats ();
+  printf ("%-16s %6s %6s %10s %12s %12s\n", "workqueue", "depth",
+          "max", "runs", "avg(us)", "max(us)");
+  for (e = list_begin (&workqueues); e != list_end (&workqueues);
+       e = list_next (e))
+    {
+      struct workqueue *wq = list_entry (e, struct workqueue, elem);
+      struct workqueue s;
+      enum intr_level old_level;
+
+      old_level = intr_disable ();
+      s = *wq;
+      intr_set_level (old_level);
+
+      printf ("%-16s %6d %6d %10lld %12llu %12llu\n", s.name, s.depth,
+              s.max_depth, s.runs,
+              s.runs != 0 ? timer_cycles_to_us (s.cycles / s.runs) : 0,
+              timer_cycles_to_us (s.max_cycles));
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef THREADS_WORKQUEUE_H
+#define THREADS_WORKQUEUE_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "threads/synch.h"
+
+/* Workqueues.
+
+   Code that must not sleep or take long, such as an interrupt
+   handler or the scheduler, can hand work off to a workqueue,
+   whose worker thread runs it later in an ordinary thread
+   context, where it may sleep and is subject to scheduling like
+   any other thread. */
+
+/* A function for a work item to run, passed the item's AUX. */
+typedef void work_func (void *aux);
+
+/* An item of deferred work.  The item's function may free the
+   item itself: the worker does not touch it once the function
+   has been called. */
+struct work
+  {
+    struct list_elem elem;      /* Element in workqueue's `items'. */
+    work_func *func;            /* Function to run. */
+    void *aux;                  /* Argument for FUNC. */
+    bool pending;               /* Queued but not yet run? */
+  };
+
+/* A queue of work items and the thread that runs them in order. */
+struct workqueue
+  {
+    const char *name;           /* Name, also used for the worker. */
+    struct list items;          /* Pending items, oldest first. */
+    struct semaphore ready;     /* Counts pending items. */
+    struct list_elem elem;      /* Element in list of all workqueues. */
+
+    /* Statistics. */
+    int depth;                  /* # of pending items. */
+    int max_depth;              /* Highest DEPTH seen. */
+    long long runs;             /* # of items run. */
+    uint64_t cycles;            /* Total run time, in TSC cycles. */
+    uint64_t max_cycles;        /* Longest run time of one item. */
+  };
+
+/* General-purpose workqueue. */
+extern struct workqueue system_wq;
+
+void workqueue_init (void);
+bool workqueue_create (struct workqueue *, const char *name, int priority);
+void work_init (struct work *, work_func *, void *aux);
+bool work_queue (struct workqueue *, struct work *);
+void workqueue_print_stats (void);
+
+#endif /* threads/workqueue.h */
@@ -0,0 +1,80 @@
+/* writevbench.c
+
+   Compares writing FRAGMENTS small fragments to a file with one
+   write() call each against writing them with a single writev()
+   call, over ROUNDS rounds each.  Usage: writevbench. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include <uio.h>
+#include "bench.h"
+
+#define FRAGMENTS 64            /* Fragments per round. */
+#define FRAGMENT_SIZE 16        /* Bytes per fragment. */
+#define ROUNDS 200              /* Rounds per method. */
+
+static const char file_name[] = "writevbench";
+static char data[FRAGMENTS][FRAGMENT_SIZE];
+
+/* Prints the cost of ROUNDS rounds that took CYCLES, for
+   METHOD. */
+static void
+report (const char *method, uint64_t cycles, uint64_t hz)
+{
+  printf ("%-7s %d rounds of %d x %d bytes: %llu cycles/round, "
+          "%llu rounds/s\n", method, ROUNDS, FRAGMENTS, FRAGMENT_SIZE,
+          cycles / ROUNDS, cycles != 0 ? ROUNDS * hz / cycles : 0);
+}
+
+int
+main (void)
+{
+  struct iovec iov[FRAGMENTS];
+  uint64_t start, hz;
+  int fd, round, i;
+
+  for (i = 0; i < FRAGMENTS; i++)
+    {
+      memset (data[i], 'a' + i % 26, FRAGMENT_SIZE);
+      iov[i].iov_base = data[i];
+      iov[i].iov_len = FRAGMENT_SIZE;
+    }
+
+  remove (file_name);
+  if (!create (file_name, sizeof data) || (fd = open (file_name)) < 0)
+    {
+      printf ("writevbench: cannot create %s\n", file_name);
+      return EXIT_FAILURE;
+    }
+  hz = bench_hz ();
+
+  start = bench_cycles ();
+  for (round = 0; round < ROUNDS; round++)
+    {
+      seek (fd, 0);
+      for (i = 0; i < FRAGMENTS; i++)
+        if (write (fd, data[i], FRAGMENT_SIZE) != FRAGMENT_SIZE)
+          {
+            printf ("writevbench: write failed\n");
+            return EXIT_FAILURE;
+          }
+    }
+  report ("write", bench_cycles () - start, hz);
+
+  start = bench_cycles ();
+  for (round = 0; round < ROUNDS; round++)
+    {
+      seek (fd, 0);
+      if (writev (fd, iov, FRAGMENTS) != (int) sizeof data)
+        {
+          printf ("writevbench: writev failed\n");
+          return EXIT_FAILURE;
+        }
+    }
+  report ("writev", bench_cycles () - start, hz);
+
+  close (fd);
+  return EXIT_SUCCESS;
+}